@@ -6,70 +6,116 @@
 #include <stdlib.h>
 #include <stdio.h>
 
-#include <avr/interrupt.h>
+#include "hal.h"
 
 #include "ili934x.h"
 #include "lcd.h"
 #include "ruota.h"
+#include "rotary.h"
+#include "profile.h"
+#include "latency.h"
+#include "clock.h"
+#include "history.h"
+#include "repetition.h"
+#include "fen.h"
+#include "pgn.h"
+#include "save.h"
+#include "uart.h"
+#include "uci.h"
+#include "memory.h"
 #include "chess.h"
+#include "sprites.h"
+#include "rules.h"
 
 
-
-uint8_t get_piece_type_at(uint8_t, uint8_t, game_state);
-uint8_t get_piece_first_state_at(uint8_t, uint8_t, game_state);
-uint8_t get_piece_index_by_type(uint8_t, uint8_t, uint8_t, game_state);
-int8_t get_piece_index_in_game_state(piece, game_state);
-
-uint8_t calc_x_difference_from_past(uint8_t, uint8_t);
-uint8_t calc_y_difference_from_past(uint8_t, uint8_t);
-
-uint8_t can_move_pawn(uint8_t, game_state);
-uint8_t can_move_rook(uint8_t, game_state);
-uint8_t can_move_knight(uint8_t, game_state);
-uint8_t can_move_bishop(uint8_t, game_state);
-uint8_t detect_castling(uint8_t, game_state);
-uint8_t can_move_king(uint8_t, game_state);
-
-uint8_t is_move_valid(piece, game_state);
-uint8_t check_in_check(game_state);
-uint8_t check_checkmate(game_state);
-
-uint8_t will_take_piece(game_state);
-game_state take_piece(game_state);
-rectangle get_piece_rectangle_from_coords(uint8_t, uint8_t, game_state);
-game_state move_and_possibly_take_piece(game_state);
-
-uint8_t is_turn_valid(piece p, game_state);
-
-uint8_t is_possible_move_for_piece(piece, game_state);
-uint8_t are_there_possible_moves(game_state);
-move_set get_possible_moves_for_piece(piece, game_state);
-
 uint8_t is_pawn_at_other_side();
 uint8_t get_index_of_pawn_at_other_side();
 void check_switches();
+void handle_promotion_event(switch_event);
+void handle_switch_event(switch_event);
+void handle_centre_press();
+void check_rotary();
+void note_input(uint16_t);
+void handle_menu_event(switch_event);
+void handle_game_over_event(switch_event);
 
 void change_turn();
 
-rectangle get_rectangle_for_selector();
+uint32_t get_taken_mask();
+packed_move make_selected_move(undo_record *);
+void replay_move(packed_move, undo_record *);
+void save_last_move();
+void undo_move();
+void redo_move();
+void after_history_step(uint8_t);
+void end_game();
+void clear_result();
+void resave_game();
+
 void update_selected();
+void move_selector_to(uint8_t, uint8_t);
+void move_selector(int8_t, int8_t);
+void step_selector(int16_t);
+void step_through_possible_moves(int16_t);
+void flip_board();
 
 void create_board();
 void create_pieces();
 void create_selector();
-void first_draw();
+void redraw_board();
 void init_game();
 
+rectangle get_square_rectangle(uint8_t, uint8_t);
+rectangle get_piece_rectangle_from_coords(uint8_t, uint8_t, game_state);
+
+rectangle get_hint_rectangle(uint8_t, uint8_t);
+void show_hint(uint8_t, uint8_t);
+void hide_hint(uint8_t, uint8_t, game_state);
 void draw_possible_moves();
+void get_selector_rectangles(selector, rectangle *);
 void draw_select(selector);
+void draw_select_saving_under(selector);
+void blit_white_on_light(sprite *);
+void blit_white_on_dark(sprite *);
+void blit_black_on_light(sprite *);
+void blit_black_on_dark(sprite *);
+sprite *get_piece_sprite(piece);
 void draw_piece(piece);
+void draw_piece_region(piece, rectangle);
 void draw_tile(tile);
+void draw_board(game_state);
 
 void refresh_tile(uint8_t, uint8_t, game_state);
 void draw_over_potential_moves(move_set, game_state);
 void refresh_en_passant_tile(game_state);
 void refresh_castling_tile(game_state);
 
+void open_menu();
+void close_menu();
+void menu_flip_board();
+void draw_menu();
+void draw_profile_page();
+void draw_latency_page();
+void draw_cpu_page();
+void draw_memory_page();
+
+void menu_next_time_control();
+void menu_undo();
+void menu_load_position();
+void load_position(PGM_P);
+uint8_t set_position(char *);
+void resume_game();
+void follow_uci_position();
+void menu_redo();
+void menu_export_pgn();
+
+void load_clock_glyphs();
+void reset_clock();
+void draw_clocks();
+void draw_clock_text(uint8_t, char *, uint16_t);
+
+void sleep_until_event();
+
 int main();
 
 
@@ -86,9 +132,98 @@ int main();
 
 
 
-volatile game_state current_state;
-volatile move_set current_move_set;
-volatile tile board[64];
+// OWNED BY THE MAIN LOOP. INTERRUPT HANDLERS ONLY TOUCH THE INPUT QUEUES (ruota.c, rotary.c, uart.c)
+game_state current_state;
+move_set current_move_set;
+tile board[64];
+
+// Move hints currently on screen, one bit per square (bit x of row y)
+uint8_t hint_layer[8];
+
+// Panel pixels under the selector frame, put back when only the cursor moves
+uint16_t select_under_pixels[SELECT_UNDER_PIXELS];
+save_under select_under = {{{0}}, 0, SELECT_UNDER_PIXELS, select_under_pixels};
+
+// View only: when set, black is at the bottom of the screen
+uint8_t board_flipped;
+// View only: what the pawn waiting to promote is shown as, 0 until east or west picks
+sprite *promotion_sprite;
+uint8_t full_redraw_pending;
+uint8_t centre_hold_used;
+// Set once the result is shown: the board takes no moves until undo or a new position
+uint8_t game_over;
+
+// Time of the last wheel detent, for acceleration
+uint16_t last_rotary_tick;
+
+// Menu drawn over the board, opened by holding the centre button
+const menu_item menu_items[MENU_ITEMS] = {
+    {"FLIP BOARD", menu_flip_board, 0},
+    {"PROFILE",    0,               draw_profile_page},
+    {"LATENCY",    0,               draw_latency_page},
+    {"CPU",        0,               draw_cpu_page},
+    {"MEMORY",     0,               draw_memory_page},
+    {"TIME CONTROL", menu_next_time_control, 0},
+    {"UNDO",       menu_undo,       0},
+    {"REDO",       menu_redo,       0},
+    {"LOAD POSITION", menu_load_position, 0},
+    {"EXPORT PGN", menu_export_pgn, 0},
+};
+uint8_t menu_open;
+uint8_t menu_index;
+uint8_t menu_page_open;
+uint8_t menu_dirty;
+
+// Oldest input not yet on screen, in Timer 3 ticks
+uint8_t input_pending;
+uint16_t input_time;
+
+// Clocks drawn in the side panels, one character at a time when it changes
+const time_control time_controls[TIME_CONTROLS] = {
+    {300, 3, CLOCK_FISCHER},
+    {600, 5, CLOCK_BRONSTEIN},
+    {180, 2, CLOCK_FISCHER},
+    {0,   0, CLOCK_FISCHER}, // UNTIMED
+};
+uint8_t time_control_index;
+chess_clock game_clock;
+glyph clock_glyphs[11]; // 0-9 AND ':'
+char clock_shown[2][5];
+uint16_t clock_shown_col[2];
+
+// Moves made this game, for undo and redo
+move_history history;
+
+// Keys of the positions this game has been through, for draws by repetition
+key_stack game_keys;
+
+// The game as it is played, kept in EEPROM so it survives a power cycle
+save_state game_save;
+
+// A UCI GUI driving the engine over USART1
+uci_state uci;
+
+// Puzzles and regression positions for LOAD POSITION, kept in flash
+const char position_kiwipete[] PROGMEM = "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1";
+const char position_en_passant[] PROGMEM = "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3";
+const char position_promotion[] PROGMEM = "8/P6k/8/8/8/8/6Kp/8 w - - 0 1";
+const char position_mate_in_one[] PROGMEM = "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1";
+const char position_endgame[] PROGMEM = "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1";
+const char position_start[] PROGMEM = START_FEN;
+PGM_P const positions[POSITIONS] PROGMEM = {
+    position_kiwipete,
+    position_en_passant,
+    position_promotion,
+    position_mate_in_one,
+    position_endgame,
+    position_start,
+};
+uint8_t position_index;
+
+// Time spent asleep in the current accounting window, in Timer 3 ticks
+uint32_t busy_window_start;
+uint32_t idle_ticks;
+uint16_t busy_permille;
 
 
 
@@ -114,634 +249,593 @@ ISR(TIMER1_COMPA_vect) {
 }
 
 ISR(TIMER3_COMPA_vect) {
-    // TODO USE
+    profile_second();
 }
 
+ISR(EE_READY_vect) {
+    save_ready(&game_save);
+}
 
+ISR(USART1_RX_vect) {
+    uart_received();
+}
+
+ISR(USART1_UDRE_vect) {
+    uart_transmit_ready();
+}
 
 
 
 
-uint8_t get_piece_type_at(uint8_t temp_x, uint8_t temp_y, game_state g) {
-    uint8_t i;
-    for (i=0; i<32; i++) {
-        if (g.pieces[i].x==temp_x && g.pieces[i].y==temp_y && i!=g.selected_piece_index && g.pieces[i].taken==0) return g.pieces[i].type;
-    }
 
-    return 0;
-}
 
-uint8_t get_piece_first_state_at(uint8_t temp_x, uint8_t temp_y, game_state g) {
+uint8_t is_pawn_at_other_side() {
     uint8_t i;
     for (i=0; i<32; i++) {
-        if (g.pieces[i].x==temp_x && g.pieces[i].y==temp_y && i!=g.selected_piece_index && g.pieces[i].taken==0) return g.pieces[i].first;
+        if (current_state.pieces[i].team==0 && current_state.pieces[i].type==1 && current_state.pieces[i].y==0) return 1;
+
+        if (current_state.pieces[i].team==1 && current_state.pieces[i].type==7 && current_state.pieces[i].y==7) return 1;
     }
 
     return 0;
 }
 
-uint8_t get_piece_index_by_type(uint8_t type, uint8_t x, uint8_t y, game_state g) {
+uint8_t get_index_of_pawn_at_other_side() {
     uint8_t i;
     for (i=0; i<32; i++) {
-        if (g.pieces[i].x==x && g.pieces[i].y==y && g.pieces[i].taken==0 && g.pieces[i].type==type) return i;
+        if (current_state.pieces[i].team==0 && current_state.pieces[i].type==1 && current_state.pieces[i].y==0) return i;
+
+        if (current_state.pieces[i].team==1 && current_state.pieces[i].type==7 && current_state.pieces[i].y==7) return i;
     }
 
     return 0;
 }
 
-int8_t get_piece_index_in_game_state(piece p, game_state g) {
-    uint8_t i;
-    for (i=0; i<32; i++) {
-        if (g.pieces[i].x==p.x && g.pieces[i].y==p.y && g.pieces[i].taken==0 && g.pieces[i].type==p.type) return i;
+void check_switches() {
+    PROFILE_BEGIN(PROF_CHECK_SWITCHES);
+    // RUNS WITH INTERRUPTS ENABLED: scan_switches KEEPS QUEUEING EVENTS WHILE MOVES ARE GENERATED
+    if (is_pawn_at_other_side() && current_state.select.active==0) { // STALL ALL OTHER INPUT CHANGES UNTIL PAWN NO LONGER AT OTHER SIDE
+        uint8_t index = get_index_of_pawn_at_other_side();
+        current_state.select.x = current_state.pieces[index].x;
+        current_state.select.y = current_state.pieces[index].y;
+        current_state.select.col = MAGENTA;
+        current_state.select.active = 0;
     }
 
-    return 0;
+    switch_event e;
+    while (get_switch_event(&e)) {
+        if (menu_open) {
+            handle_menu_event(e);
+        } else if (is_pawn_at_other_side() && current_state.select.active==0) {
+            handle_promotion_event(e);
+        } else if (game_over) {
+            handle_game_over_event(e);
+        } else {
+            handle_switch_event(e);
+        }
+        note_input(e.time);
+    }
+
+    check_rotary();
+    PROFILE_END(PROF_CHECK_SWITCHES);
 }
 
+void check_rotary() {
+    int8_t detents = get_rotary_delta();
+    if (detents==0) return;
 
+    // FAST SPINS COVER MORE SQUARES PER DETENT
+    uint16_t now = get_switch_ticks();
+    uint16_t gap = now - last_rotary_tick;
+    last_rotary_tick = now;
+
+    if (menu_open) {
+        if (menu_page_open==0) {
+            menu_index = ((menu_index + detents) % MENU_ITEMS + MENU_ITEMS) % MENU_ITEMS;
+            menu_dirty = MENU_DIRTY_LABELS;
+        }
+        return;
+    }
 
+    if (game_over) return;
 
+    int16_t steps = detents;
+    if (gap < ROTARY_FAST_TICKS) {
+        steps *= 3;
+    } else if (gap < ROTARY_MEDIUM_TICKS) {
+        steps *= 2;
+    }
 
+    if (is_pawn_at_other_side() && current_state.select.active==0) {
+        // WHEEL PICKS THE PROMOTION PIECE LIKE EAST/WEST
+        switch_event e = {SWITCH_PRESS, detents > 0 ? _BV(SWE) : _BV(SWW), profile_now()};
+        handle_promotion_event(e);
+    } else {
+        if (current_state.select.active) {
+            step_through_possible_moves(detents); // ONE DESTINATION PER DETENT, THE LIST IS SHORT
+        } else {
+            step_selector(steps);
+        }
 
+        update_selected();
+    }
 
-uint8_t calc_x_difference_from_past(uint8_t x, uint8_t p_x) {
-    if (x>p_x)
-        return x-p_x;
-    else
-        return p_x-x;
+    // WHEEL COUNTS ARE TIMED WHEN READ, NOT WHEN TURNED
+    note_input(profile_now());
 }
 
-uint8_t calc_y_difference_from_past(uint8_t y, uint8_t p_y) {
-    if (y>p_y)
-        return y-p_y;
-    else
-        return p_y-y;
+void note_input(uint16_t time) {
+    // LATENCY RUNS FROM THE FIRST INPUT SINCE THE LAST DRAW THAT CALLED FOR A REDRAW
+    if (input_pending==0 && current_state.has_drawn==0) {
+        input_pending = 1;
+        input_time = time;
+    }
 }
 
+void handle_promotion_event(switch_event e) {
+    if (e.type!=SWITCH_PRESS) return;
 
+    uint8_t index = get_index_of_pawn_at_other_side();
+    uint8_t team = current_state.pieces[index].team;
 
+    if (e.switches==_BV(SWE)) {
+        promotion_sprite = &queen;
+        current_state.board_past_x = current_state.select.x;
+        current_state.board_past_y = current_state.select.y;
+        current_state.has_drawn = 0;
+    }
 
+    if (e.switches==_BV(SWW)) {
+        promotion_sprite = &knight;
+        current_state.board_past_x = current_state.select.x;
+        current_state.board_past_y = current_state.select.y;
+        current_state.has_drawn = 0;
+    }
 
+    if (e.switches==_BV(SWC) && promotion_sprite) {
+        // THE PAWN'S MOVE IS ALREADY IN THE HISTORY, ADD THE PIECE IT BECAME
+        packed_move last = history_ply(&history, history.current-1);
+        uint8_t promotion = promotion_sprite==&knight ? PROMOTE_KNIGHT : PROMOTE_QUEEN;
+        history_set_last(&history, PACK_MOVE(MOVE_FROM(last), MOVE_TO(last), MOVE_PROMOTION, promotion));
+        save_last_move();
 
-
-uint8_t can_move_pawn(uint8_t index, game_state g) {
-    piece p = g.pieces[index];
-    uint8_t temp_type;
-
-    if (p.type==1) {
-        if (p.first==1) {
-            if (p.y==(g.past_y-2)) {
-                if (p.x==g.past_x) {
-                    if (get_piece_type_at(p.x, p.y, g)==0) {
-                        return 1; // FIRST MOVE so can move 2 forwards
-                    }
-                }
+        if (promotion_sprite==&knight) {
+            if (team) {
+                current_state.pieces[index].type = 9;
+            } else {
+                current_state.pieces[index].type = 3;
             }
-        }
 
+            current_state.board_past_x = current_state.select.x;
+            current_state.board_past_y = current_state.select.y;
+            current_state.has_drawn = 0;
+            current_state.select.active = 0;
 
-        if (p.y==(g.past_y-1)) {
-            if (p.x==g.past_x)
-                if (get_piece_type_at(p.x, p.y, g)==0) 
-                    return 1; // IF STAYED IN SAME COLUMN then allow move if square empty
-
-            if (p.x==(g.past_x-1) || p.x==(g.past_x+1)) {
-                temp_type = get_piece_type_at(p.x, p.y, g);
-                if (temp_type>6) {
-                    return 1; // IF MOVED DIAGONALLY then allow move if square is occupied by opponents piece
-                }
-            }
-        }
-
-        if (g.can_en_passant) {
-            if (p.y==g.en_passant_y-1 && p.x==g.en_passant_x && g.past_y==g.en_passant_y) {
-                return 1;
-            }
-        }
-    } else {
-        if (p.first==1) {
-            if (p.y==(g.past_y+2)) {
-                if (p.x==g.past_x) {
-                    if (get_piece_type_at(p.x, p.y, g)==0) {
-                        return 1; // FIRST MOVE so can move 2 forwards
-                    }
-                }
+            update_selected();
+        } else if (promotion_sprite==&queen) {
+            if (team) {
+                current_state.pieces[index].type = 11;
+            } else {
+                current_state.pieces[index].type = 5;
             }
-        }
-
 
-        if (p.y==(g.past_y+1)) {
-            if (p.x==g.past_x)
-                if (get_piece_type_at(p.x, p.y, g)==0) 
-                    return 1; // IF STAYED IN SAME COLUMN then allow move if square empty
+            current_state.board_past_x = current_state.select.x;
+            current_state.board_past_y = current_state.select.y;
+            current_state.has_drawn = 0;
+            current_state.select.active = 0;
 
-            if (p.x==(g.past_x-1) || p.x==(g.past_x+1)) {
-                temp_type = get_piece_type_at(p.x, p.y, g);
-                if (temp_type<7 && temp_type>0) {
-                    return 1; // IF MOVED DIAGONALLY then allow move if square is occupied by opponents piece
-                }
-            }
+            update_selected();
         }
 
-        if (g.can_en_passant) {
-            if (p.y==g.en_passant_y+1 && p.x==g.en_passant_x && g.past_y==g.en_passant_y) {
-                return 1;
-            }
-        }
+        repetition_set_last(&game_keys, &current_state);
+        promotion_sprite = 0;
     }
-
-    return 0;
 }
 
-uint8_t can_move_rook(uint8_t index, game_state g) {
-    piece p = g.pieces[index];
-
-    if (p.x==g.past_x) {
-        // Check column for pieces in the way
-        uint8_t i;
-        for (i=0; i<32; i++)
-            if (i!=index && g.pieces[i].taken==0 && g.pieces[i].x==p.x && ((g.pieces[i].y>=g.past_y && g.pieces[i].y<p.y) || (g.pieces[i].y<=g.past_y && g.pieces[i].y>p.y)))
-                return 0; // Cannot move as pieces in the way
-
-        // No pieces between select and move position
-        for (i=0; i<32; i++)
-            if (i!=index && g.pieces[i].taken==0 && g.pieces[i].x==p.x && g.pieces[i].y==p.y && g.pieces[i].team==g.turn)
-                return 0; // Cannot take the piece we are on top of
-
-        return 1;
+void handle_game_over_event(switch_event e) {
+    // ONLY THE MENU IS LEFT, SO UNDO AND LOAD POSITION CAN CARRY ON FROM HERE
+    if (e.switches!=_BV(SWC)) return;
+    if (e.type==SWITCH_PRESS) {
+        centre_hold_used = 0;
+    } else if (e.type==SWITCH_LONG && centre_hold_used==0) {
+        centre_hold_used = 1;
+        open_menu();
     }
+}
 
-    if (p.y==g.past_y) {
-        // Check row for pieces in the way
-        uint8_t i;
-        for (i=0; i<32; i++)
-            if (i!=index && g.pieces[i].taken==0 && g.pieces[i].y==p.y && ((g.pieces[i].x>=g.past_x && g.pieces[i].x<p.x) || (g.pieces[i].x<=g.past_x && g.pieces[i].x>p.x)))
-                return 0; // Cannot move as pieces are in the way
-
-        for (i=0; i<32; i++)
-            if (i!=index && g.pieces[i].taken==0 && g.pieces[i].x==p.x && g.pieces[i].y==p.y && g.pieces[i].team==g.turn)
-                return 0; // Cannot take the piece we are on top of
-
-        return 1;
+void handle_switch_event(switch_event e) {
+    if (e.switches==_BV(SWC)) {
+        if (e.type==SWITCH_PRESS) {
+            handle_centre_press();
+        } else if (e.type==SWITCH_LONG && centre_hold_used==0 && current_state.select.active==0) {
+            // HOLDING THE CENTRE BUTTON WITHOUT PICKING ANYTHING UP OPENS THE MENU
+            centre_hold_used = 1;
+            open_menu();
+        }
+    } else {
+        // DIRECTIONS AUTO-REPEAT WHILE HELD
+        if (e.switches==_BV(SWE)) move_selector(1, 0);
+        if (e.switches==_BV(SWW)) move_selector(-1, 0);
+        if (e.switches==_BV(SWS)) move_selector(0, 1);
+        if (e.switches==_BV(SWN)) move_selector(0, -1);
     }
 
-    return 0;
+    update_selected();
 }
 
-uint8_t can_move_knight(uint8_t index, game_state g) {
-    piece p = g.pieces[index];
-
-    uint8_t temp_type;
-
-    if (((p.x==(g.past_x+1) || p.x==(g.past_x-1)) && (p.y==(g.past_y-2) || p.y==(g.past_y+2))) ||
-        ((p.x==(g.past_x+2) || p.x==(g.past_x-2)) && (p.y==(g.past_y-1) || p.y==(g.past_y+1)))) { // Across 1, up / down 2 || Across 2, up / down 1
-        if (g.turn==0) {
-            temp_type = get_piece_type_at(p.x, p.y, g);
-            if (temp_type>6) {
-                return 1;
-            } else if (temp_type==0) {
-                return 1;
-            } else {
-                return 0;
-            }
+void handle_centre_press() {
+    centre_hold_used = 0;
+    if (current_state.select.active==1) {
+        centre_hold_used = 1;
+        if (current_state.pieces[current_state.selected_piece_index].x==current_state.past_x && current_state.pieces[current_state.selected_piece_index].y==current_state.past_y) {
+            update_selected();
+            current_state.board_past_x = current_state.select.x;
+            current_state.board_past_y = current_state.select.y;
+            current_state.has_drawn = 0;
+            current_state.select.active = 0;
         } else {
-            temp_type = get_piece_type_at(p.x, p.y, g);
-            if (temp_type<7) {
-                if (temp_type==0) {
-                    return 1;
-                } else {
-                    return 1;
-                }
-            } else {
-                return 0;
+            if (is_turn_valid(current_state.pieces[current_state.selected_piece_index], current_state)) {
+                undo_record u;
+                packed_move m = make_selected_move(&u);
+                history_push(&history, m, u);
+                save_last_move();
+                if (time_controls[time_control_index].seconds) clock_press(&game_clock, profile_now());
             }
         }
-    }
-
-    return 0;
-}
-
-uint8_t can_move_bishop(uint8_t index, game_state g) {
-    piece p = g.pieces[index];
-
-    uint8_t temp_type;
-
-    uint8_t dif_x = calc_x_difference_from_past(p.x, g.past_x);
-    uint8_t dif_y = calc_y_difference_from_past(p.y, g.past_y);
-
-    if (dif_x==dif_y) { // If moved diagonally
-        uint8_t i, p_dif_x, p_dif_y;
+    } else {
+        uint8_t i;
         for (i=0; i<32; i++) {
-            if (i!=index) {
-                p_dif_x = calc_x_difference_from_past(g.pieces[i].x, g.past_x);
-                p_dif_y = calc_y_difference_from_past(g.pieces[i].y, g.past_y);
-
-                if (p_dif_y==p_dif_x) { // Piece is on the diagonal and in the way (tested below)
-                    if (((g.pieces[i].x>=g.past_x && g.pieces[i].x<p.x) || (g.pieces[i].x<=g.past_x && g.pieces[i].x>p.x)) && ((g.pieces[i].y>=g.past_y && g.pieces[i].y<p.y) || (g.pieces[i].y<=g.past_y && g.pieces[i].y>p.y)) && g.pieces[i].taken==0) {
-                        return 0;
-                    }
-                }
+            if (current_state.pieces[i].x==current_state.select.x && current_state.pieces[i].y==current_state.select.y && current_state.pieces[i].team==current_state.turn && current_state.pieces[i].taken==0) {
+                current_state.selected_piece_index = i;
+                current_state.select.active = 1;
+                current_state.past_x = current_state.select.x;
+                current_state.past_y = current_state.select.y;
+                break;
             }
         }
-        
-        temp_type = get_piece_type_at(p.x, p.y, g);
-        if (g.turn==0) {
-            if (temp_type>6) {
-                return 1;
-            } else if (temp_type==0) {
-                return 1;
-            } else {
-                return 0;
-            }   
-        } else {
-            if (temp_type<7) {
-                if (temp_type==0) {
-                    return 1;
-                } else {
-                    return 1;
-                }
-            } else {
-                return 0;
-            }
+
+        if (current_state.select.active) {
+            centre_hold_used = 1;
+            current_state.board_past_x = current_state.select.x;
+            current_state.board_past_y = current_state.select.y;
+            current_state.has_drawn = 0;
+            current_move_set = get_possible_moves_for_piece(current_state.pieces[current_state.selected_piece_index], current_state);
         }
     }
-    return 0;
 }
 
-uint8_t detect_castling(uint8_t index, game_state g) {
-    // CASTLING DETECTION
-    piece p = g.pieces[index];
 
-    uint8_t turn_rook;
-    if (g.turn) {
-        turn_rook = 8;
-    } else {
-        turn_rook = 2;
-    }
 
-    uint8_t piece_type;
-    uint8_t left  = 1;
-    uint8_t right = 1;
-    
-    uint8_t j;
-    if (p.first==1 && (g.past_x==(p.x+2) || g.past_x==(p.x-2)) && (p.y==0 || p.y==7)) {
-        uint8_t left_piece_type  = get_piece_type_at(0, p.y, g);
-        uint8_t left_piece_first = get_piece_first_state_at(0, p.y, g);
-        uint8_t right_piece_type = get_piece_type_at(7, p.y, g);
-        uint8_t right_piece_first = get_piece_first_state_at(7, p.y, g);
 
-    
-        if (left_piece_type!=turn_rook || left_piece_first==0) {
-            left = 0;
-        }
 
-        if (right_piece_type!=turn_rook || right_piece_first==0) {
-            right = 0;
-        }
-        
+void change_turn() {
+    if (current_state.turn) current_state.turn = 0;
+    else current_state.turn = 1;
+}
 
-        if (left==0 && right==0) {
-            return 0;
-        }
 
-        for (j=0; j<4; j++) {
-            piece_type = get_piece_type_at(p.x-j, p.y, g);
-            if (piece_type!=0 && piece_type!=turn_rook) {
-                left = 0;
-            }
-        }
 
-        for (j=0; j<3; j++) {
-            piece_type = get_piece_type_at(p.x+j, p.y, g);
-            if (piece_type!=0 && piece_type!=turn_rook) {
-                right = 0;
-            }
-        }
 
-        if (left || right) {
-            return 1;
-        }
+
+
+uint32_t get_taken_mask() {
+    uint32_t mask = 0;
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (current_state.pieces[i].taken) mask |= (uint32_t)1 << i;
     }
 
-    return 0;
+    return mask;
 }
 
-uint8_t can_move_king(uint8_t index, game_state g) {
-    piece p = g.pieces[index];
+packed_move make_selected_move(undo_record *u) {
+    // SELECTED PIECE IS ALREADY ON THE SELECTOR, past_x/past_y IS WHERE IT CAME FROM
+    piece p = current_state.pieces[current_state.selected_piece_index];
+    uint8_t from = current_state.past_y*8 + current_state.past_x;
+    uint8_t to = p.y*8 + p.x;
+
+    u->first = p.first;
+    u->en_passant = current_state.can_en_passant ? current_state.en_passant_y*8 + current_state.en_passant_x : NO_EN_PASSANT;
+    u->captured = NO_CAPTURE;
+    u->halfmove_clock = current_state.halfmove_clock;
+
+    // A PROMOTION STAYS NORMAL UNTIL THE PIECE IS PICKED, THEN history_set_last ADDS IT
+    uint8_t flags = move_flags(current_state, p.type, from, to);
+    if (flags==MOVE_PROMOTION) flags = MOVE_NORMAL;
+
+    uint8_t irreversible = p.type==1 || p.type==7 || will_take_piece(current_state);
+    uint32_t taken = get_taken_mask();
+    current_state = move_and_possibly_take_piece(current_state);
+    current_state = count_move(current_state, irreversible);
+    change_turn();
+    repetition_push(&game_keys, &current_state);
+    taken = get_taken_mask() & ~taken;
 
-    uint8_t temp_type;
-
-    uint8_t dif_x = calc_x_difference_from_past(p.x, g.past_x);
-    uint8_t dif_y = calc_y_difference_from_past(p.y, g.past_y);
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (taken & ((uint32_t)1 << i)) u->captured = i;
+    }
 
-    if (dif_x<=1 && dif_y<=1) {
-        temp_type = get_piece_type_at(p.x, p.y, g);
-        if (g.turn==0) {
-            if (temp_type>6) {
-                return 1;
-            } else if (temp_type==0) {
-                return 1;
-            } else {
-                return 0;
-            }
-        } else {
-            if (temp_type<7) {
-                if (temp_type==0) {
-                    return 1;
-                } else {
-                    return 1;
-                }  
-            } else {
-                return 0;
-            }
-        }
-    } else return detect_castling(index, g);
+    return PACK_MOVE(from, to, flags, 0);
 }
 
+void undo_move() {
+    if (!history_can_undo(&history)) return;
 
+    undo_record u;
+    packed_move m = history_undo(&history, &u);
+    current_state = unmake_move(current_state, m, u);
+    repetition_pop(&game_keys);
+    if (game_over) {
+        resave_game();
+    } else {
+        save_truncate(&game_save, history.current);
+    }
+    if (time_controls[time_control_index].seconds) clock_switch(&game_clock, profile_now());
 
+    after_history_step(MOVE_FROM(m));
+}
 
+void replay_move(packed_move m, undo_record *u) {
+    uint8_t from = MOVE_FROM(m);
+    uint8_t to = MOVE_TO(m);
+
+    // REPLAY IT THE WAY THE PLAYER MADE IT: PICK UP, DRAG TO THE SQUARE, PUT DOWN
+    uint8_t index = get_piece_index_at(from%8, from/8, current_state);
+    current_state.selected_piece_index = index;
+    current_state.past_x = from%8;
+    current_state.past_y = from/8;
+    current_state.select.x = to%8;
+    current_state.select.y = to/8;
+    current_state.pieces[index].x = to%8;
+    current_state.pieces[index].y = to/8;
+
+    make_selected_move(u);
+    if (MOVE_FLAGS(m)==MOVE_PROMOTION) {
+        current_state = promote_piece(current_state, index, MOVE_PROMOTES_TO(m));
+        repetition_set_last(&game_keys, &current_state);
+    }
+}
 
-uint8_t is_move_valid(piece p, game_state g) {
-    if (p.x==g.past_x && p.y==g.past_y) return 1;
-
-    uint8_t i;
-    uint8_t index = 0;
-    for (i=0; i<32; i++) {
-        if (g.pieces[i].x==p.x && g.pieces[i].y==p.y && g.pieces[i].type==p.type && g.pieces[i].first==p.first) index = i;
+void save_last_move() {
+    // ONE RECORD PER MOVE; WHEN THE SLOT IS FULL OR THE QUEUE WAS, CARRY ON IN A NEW SAVE FROM HERE
+    if (!save_move(&game_save, history.current-1, history_ply(&history, history.current-1))) {
+        char fen[FEN_MAX];
+        fen_write(&current_state, fen);
+        save_begin(&game_save, fen, history.current);
     }
+}
 
-    // PAWN
-    if (p.type==1 || p.type==7) return can_move_pawn(index, g);
+void redo_move() {
+    if (!history_can_redo(&history)) return;
+    if (game_over) resave_game();
 
+    packed_move m = history_redo(&history);
+    undo_record u;
+    replay_move(m, &u);
+    history_redone(&history, u);
+    save_last_move();
+    if (time_controls[time_control_index].seconds) clock_switch(&game_clock, profile_now());
 
-    // ROOK
-    if (p.type==2 || p.type==8) return can_move_rook(index, g);
-    
+    after_history_step(MOVE_TO(m));
+}
 
-    // KNIGHT
-    if (p.type==3 || p.type==9) return can_move_knight(index, g);
+void after_history_step(uint8_t square) {
+    current_state.select.active = 0;
+    move_selector_to(square%8, square/8);
+    update_selected();
 
+    // A CLOCK STOPPED AT THE END STARTS AGAIN WITH THE NEXT MOVE MADE
+    clock_set_side(&game_clock, current_state.turn);
 
-    // BISHOP
-    if (p.type==4 || p.type==10) return can_move_bishop(index, g);
+    full_redraw_pending = 1;
+    current_state.has_drawn = 0;
+}
 
+void end_game() {
+    // THE RESULT STAYS ON SCREEN, BUT THERE IS NOTHING LEFT TO RESUME AT POWER-UP
+    game_over = 1;
+    full_redraw_pending = 1; // THE LAST MOVE WAS NOT DRAWN YET
+    save_finish(&game_save);
+    if (time_controls[time_control_index].seconds) clock_stop(&game_clock, profile_now());
+}
 
-    // QUEEN
-    if (p.type==5 || p.type==11) return can_move_rook(index, g) || can_move_bishop(index, g);
+void clear_result() {
+    // THE RESULT PANEL IS OUTSIDE THE BOARD, SO NO REDRAW COVERS IT
+    if (game_over) {
+        rectangle r = {0,RESULT_RIGHT,0,RESULT_BOTTOM};
+        fill_rectangle(r, BLACK);
+    }
+    game_over = 0;
+}
 
+void resave_game() {
+    // TAKEN BACK FROM THE END: THE FINISHED GAME WAS WIPED, SO SAVE AGAIN FROM HERE
+    char fen[FEN_MAX];
+    clear_result();
+    fen_write(&current_state, fen);
+    save_begin(&game_save, fen, history.current);
+}
 
-    // KING
-    if (p.type==6 || p.type==12) return can_move_king(index, g);
 
-    return 0;
-}
 
-uint8_t check_in_check(game_state g) {
-    uint8_t king_x;
-    uint8_t king_y;
 
-    uint8_t i;
-    for (i=0; i<32; i++) {
-        if (g.turn==0 && g.pieces[i].type==6) {
-            king_x = g.pieces[i].x;
-            king_y = g.pieces[i].y;
-            break;
-        } else if (g.turn && g.pieces[i].type==12) {
-            king_x = g.pieces[i].x;
-            king_y = g.pieces[i].y;
-            break;
+
+void update_selected() {
+    if (current_state.select.active) {
+        if ((is_turn_valid(current_state.pieces[current_state.selected_piece_index], current_state)) || 
+            (current_state.pieces[current_state.selected_piece_index].x==current_state.past_x && current_state.pieces[current_state.selected_piece_index].y==current_state.past_y)) {
+            current_state.select.col = 0x07FF; // CYAN
         } else {
-            continue;
+            current_state.select.col = 0xF800; // RED
         }
-    }
-
-    //g.turn = (!g.turn);
 
-    for (i=0; i<32; i++) {
-        if (g.pieces[i].team!=g.turn && g.pieces[i].taken==0) {
-            // IF CAN MOVE ONTO KING; CHECK AND BREAK
-            g.past_x = g.pieces[i].x;
-            g.past_y = g.pieces[i].y;
-
-            g.pieces[i].x = king_x;
-            g.pieces[i].y = king_y;
-            if (is_move_valid(g.pieces[i], g)) {
-                return 1;
+        current_state.pieces[current_state.selected_piece_index].x = current_state.select.x;
+        current_state.pieces[current_state.selected_piece_index].y = current_state.select.y;
+    } else {
+        uint8_t i;
+        for (i=0; i<32; i++) {
+            if (current_state.pieces[i].x==current_state.select.x && current_state.pieces[i].y==current_state.select.y && current_state.pieces[i].team==current_state.turn && current_state.pieces[i].taken==0) {
+                current_state.select.col = 0x07E0; // GREEN
+                return;
             }
-
-            // Restore to original position
-            g.pieces[i].x = g.past_x;
-            g.pieces[i].y = g.past_y;
         }
+
+        current_state.select.col = 0xFFE0; // YELLOW
     }
+}
 
-    return 0;
+void move_selector_to(uint8_t x, uint8_t y) {
+    // REMEMBER WHERE THE SELECTOR WAS LAST DRAWN, NOT ANY SQUARE IT PASSED THROUGH SINCE
+    if (current_state.has_drawn) {
+        current_state.board_past_x = current_state.select.x;
+        current_state.board_past_y = current_state.select.y;
+    }
+    current_state.select.x = x;
+    current_state.select.y = y;
+    current_state.select.r = get_square_rectangle(x, y);
+    current_state.has_drawn = 0;
+    current_state.cursor_moved = 1;
 }
 
-uint8_t check_checkmate(game_state g) {
-    if (check_in_check(g)) {
-        if (are_there_possible_moves(g)) {
-            return 1; // CHECK
-        } else {
-            return 2; // CHECKMATE
-        }
+void move_selector(int8_t dx, int8_t dy) {
+    // BUTTONS MOVE THE SELECTOR ON SCREEN, SO DIRECTIONS MIRROR WHEN THE BOARD IS FLIPPED
+    if (board_flipped) {
+        dx = -dx;
+        dy = -dy;
     }
 
-    return 0;
+    int8_t x = current_state.select.x + dx;
+    int8_t y = current_state.select.y + dy;
+    if (x<0 || x>7 || y<0 || y>7) return;
+
+    move_selector_to(x, y);
 }
 
+void step_selector(int16_t steps) {
+    // READING ORDER ON SCREEN, WRAPPING FROM THE LAST SQUARE BACK TO THE FIRST
+    uint8_t x = board_flipped ? 7-current_state.select.x : current_state.select.x;
+    uint8_t y = board_flipped ? 7-current_state.select.y : current_state.select.y;
 
+    int16_t i = ((y*8 + x + steps) % 64 + 64) % 64;
+    x = i % 8;
+    y = i / 8;
 
+    if (board_flipped) {
+        x = 7-x;
+        y = 7-y;
+    }
 
+    move_selector_to(x, y);
+}
 
+void step_through_possible_moves(int16_t steps) {
+    // ONLY LEGAL DESTINATIONS (AND THE STARTING SQUARE) WHILE A PIECE IS HELD
+    uint8_t n = current_move_set.num_possible_moves;
+    if (n==0) return;
 
-uint8_t will_take_piece(game_state g) {
-    // HANDLE IF NEEDS TO TAKE A PIECE
-    uint8_t i;
-    for (i=0; i<32; i++) {
-        // HANDLE IF NEEDS TO TAKE PIECE
-        if (g.select.x==g.pieces[i].x && g.select.y==g.pieces[i].y && i!=g.selected_piece_index && g.pieces[i].taken==0) {
-            return 1;
-        }
-    }
+    // MOVE SET IS IN BOARD ORDER, WHICH RUNS BACKWARDS ON SCREEN WHEN FLIPPED
+    if (board_flipped) steps = -steps;
 
-    // HANDLE EN PASSANT TAKING IF POSSIBLE
-    for (i=0; i<32; i++) {
-        if (g.can_en_passant && g.select.x==g.pieces[i].x && g.pieces[i].y==g.en_passant_y && g.pieces[i].x==g.en_passant_x && ((g.pieces[g.selected_piece_index].type==1 && g.select.y==g.en_passant_y-1) || (g.pieces[g.selected_piece_index].type==7 && g.select.y==g.en_passant_y+1)) && g.pieces[i].taken==0) {
-            return 1;
-        }
+    int16_t i;
+    for (i=0; i<n; i++) {
+        if (current_move_set.possible_moves_x[i]==current_state.select.x && current_move_set.possible_moves_y[i]==current_state.select.y) break;
     }
+    if (i==n) i = steps > 0 ? -1 : 0;
 
+    i = ((i + steps) % n + n) % n;
+    move_selector_to(current_move_set.possible_moves_x[i], current_move_set.possible_moves_y[i]);
+}
 
-    //for (i=0; i<32; i++) {
-    //    // HANDLE IF DOES NOT NEED TO TAKE PIECE BECAUSE PIECE IS ALREADY TAKEN
-    //    if (g.select.x==g.pieces[i].x && g.select.y==g.pieces[i].y && i!=g.selected_piece_index && g.pieces[i].taken==1) {
-    //        return 1;
-    //    }
-    //}
+void flip_board() {
+    board_flipped = !board_flipped;
 
-    return 0;
+    create_board();
+
+    current_state.select.r = get_square_rectangle(current_state.select.x, current_state.select.y);
+
+    full_redraw_pending = 1;
+    current_state.has_drawn = 0;
 }
 
-game_state take_piece(game_state g) {
-    // HANDLE IF NEEDS TO TAKE A PIECE
-    uint8_t i;
-    for (i=0; i<32; i++) {
-        // HANDLE IF NEEDS TO TAKE PIECE
-        if (g.select.x==g.pieces[i].x && g.select.y==g.pieces[i].y && i!=g.selected_piece_index && g.pieces[i].taken==0) {
-            g.board_past_x = g.select.x;
-            g.board_past_y = g.select.y;
-            g.has_drawn = 0;
-            g.pieces[i].taken = 1;
-            g.select.active = 0;
-            return g;
-        }
-    }
 
-    // HANDLE EN PASSANT TAKING IF POSSIBLE
-    for (i=0; i<32; i++) {
-        if (g.can_en_passant && g.select.x==g.pieces[i].x && g.pieces[i].y==g.en_passant_y && g.pieces[i].x==g.en_passant_x && ((g.pieces[g.selected_piece_index].type==1 && g.select.y==g.en_passant_y-1) || (g.pieces[g.selected_piece_index].type==7 && g.select.y==g.en_passant_y+1)) && g.pieces[i].taken==0) {
-            g.board_past_x = g.select.x;
-            g.board_past_y = g.select.y;
-            g.en_passant_occured = 1;
-            g.has_drawn = 0;
-            g.pieces[i].taken = 1;
-            g.select.active = 0;
-            return g;
-        }
-    }
 
 
-    //for (i=0; i<32; i++) {
-    //    // HANDLE IF DOES NOT NEED TO TAKE PIECE BECAUSE PIECE IS ALREADY TAKEN
-    //    if (g.select.x==g.pieces[i].x && g.select.y==g.pieces[i].y && i!=g.selected_piece_index && g.pieces[i].taken==1) {
-    //        g.board_past_x = g.select.x;
-    //        g.board_past_y = g.select.y;
-    //        g.has_drawn = 0;
-    //        g.select.active = 0;
-    //        return g;
-    //    }
-    //}
 
-    return g;
-}
 
-rectangle get_piece_rectangle_from_coords(uint8_t x, uint8_t y, game_state g) {
-    rectangle r = {40+(x)*TILESIZE+g.select.thickness,40+((x)*TILESIZE)+(TILESIZE-1)-g.select.thickness,(int)(y)*TILESIZE+g.select.thickness,((int)(y)*TILESIZE)+(TILESIZE-1)-g.select.thickness};
 
-    return r;
-}
-
-game_state move_and_possibly_take_piece(game_state g) {
-    if (will_take_piece(g)==0) {
-        // HANDLE CASTLING MOVEMENT IF OCCURING
-        uint8_t cst = detect_castling(g.selected_piece_index, g);
-        if ((g.pieces[g.selected_piece_index].type==6 || g.pieces[g.selected_piece_index].type==12) &&
-             cst) {
-            // CASTLING DETECTION
-            g.castling_occured = 1;
-
-            uint8_t index;
-            if (g.turn==0) {
-                if (g.select.x==6) {
-                    // RIGHT
-                    index = get_piece_index_by_type(2, 7, 7, g);
-                    g.pieces[index].r = get_piece_rectangle_from_coords(g.select.x-1, g.select.y, g);
-                    g.pieces[index].x = 5;
-                    g.pieces[index].first = 0;
-
-                    g.board_past_x = g.select.x-1;
-                    g.board_past_y = g.select.y;
-                    g.has_drawn = 0;
-                    g.select.active = 0;
-                } else if (g.select.x==2) {
-                    // LEFT
-                    index = get_piece_index_by_type(2, 0, 7, g);
-                    g.pieces[index].r = get_piece_rectangle_from_coords(g.select.x+1, g.select.y, g);
-                    g.pieces[index].x = 3;
-                    g.pieces[index].first = 0;
-
-                    g.board_past_x = g.select.x+1;
-                    g.board_past_y = g.select.y;
-                    g.has_drawn = 0;
-                    g.select.active = 0;                      
-                }
+void create_board() {
+    uint8_t i;
+    /* Create Tiles */
+    for (i=0; i<64; i++) {
+        rectangle r = get_square_rectangle(i%8, i/8);
+        tile t;
+        t.r = r;
+        if (i/8%2==0) {
+            if (i%2==0) {
+                t.col = LIGHT_BROWN; // Light brown instead of white
+                board[i] = t;
             } else {
-                if (g.select.x==6) {
-                    // RIGHT
-                    index = get_piece_index_by_type(8, 7, 0, g);
-                    g.pieces[index].r = get_piece_rectangle_from_coords(g.select.x-1, g.select.y, g);
-                    g.pieces[index].x = 5;
-                    g.pieces[index].first = 0;
-
-                    g.board_past_x = g.select.x-1;
-                    g.board_past_y = g.select.y;
-                    g.has_drawn = 0;
-                    g.select.active = 0;
-                } else if (g.select.x==2) {
-                    // LEFT
-                    index = get_piece_index_by_type(8, 0, 0, g);
-                    g.pieces[index].r = get_piece_rectangle_from_coords(g.select.x+1, g.select.y, g);
-                    g.pieces[index].x = 3;
-                    g.pieces[index].first = 0;
-
-                    g.board_past_x = g.select.x+1;
-                    g.board_past_y = g.select.y;
-                    g.has_drawn = 0;
-                    g.select.active = 0;                       
-                }
+                t.col = DARK_BROWN; // Dark brown instead of black
+                board[i] = t;
             }
         } else {
-            // CATCH ALL FOR JUST GENERIC MOVEMENT
-            g.board_past_x = g.select.x;
-            g.board_past_y = g.select.y;
-            g.has_drawn = 0;
-            g.select.active = 0;
+            if (i%2==0) {
+                t.col = DARK_BROWN;
+                board[i] = t;
+            } else {
+                t.col = LIGHT_BROWN;
+                board[i] = t;
+            }
         }
-    } else {
-        g = take_piece(g);
-    } 
+    }
+}
 
-    // SET FLAG SHOWING PIECE MOVEMENT HAS OCCURED
-    g.pieces[g.selected_piece_index].first = 0;
+void create_pieces() {
+    fen_read(START_FEN, &current_state);
+}
 
-    // RESET EN PASSANT FLAG TO AVOID CONFLICTS
-    g.can_en_passant = 0;
+void create_selector() {
+    /* Create Selector */
+    current_state.select.r = get_square_rectangle(0, 0);
+    current_state.select.thickness = 3;
+    current_state.select.col = 0x07E0;
+    current_state.select.x = 0;
+    current_state.select.y = 0;
+    current_state.select.active = 0;
+}
 
-    // Set flags ready that en_passant can occur in the next move
-    if (g.pieces[g.selected_piece_index].type==1) {
-        if (g.pieces[g.selected_piece_index].y==(g.past_y-2)) {
-            g.can_en_passant = 1;
-            g.en_passant_x = g.pieces[g.selected_piece_index].x;
-            g.en_passant_y = g.pieces[g.selected_piece_index].y;
-        }
-    }
+void redraw_board() {
+    // ONE STREAMING PASS FOR TILES AND PIECES, THEN THE OVERLAYS ON TOP
+    draw_board(current_state);
 
-    if (g.pieces[g.selected_piece_index].type==7) {
-        if (g.pieces[g.selected_piece_index].y==(g.past_y+2)) {
-            g.can_en_passant = 1;
-            g.en_passant_x = g.pieces[g.selected_piece_index].x;
-            g.en_passant_y = g.pieces[g.selected_piece_index].y;
-        }
-    }
+    uint8_t i;
+    for (i=0; i<8; i++) hint_layer[i] = 0;
+    if (current_state.select.active) draw_possible_moves();
 
-    return g;
+    draw_select_saving_under(current_state.select);
 }
 
+void init_game() {
+    create_board();
 
+    create_selector();  
 
+    // SELECTOR THICKNESS NEEDED TO MAKE PIECES
+    create_pieces();
 
+    current_state.select_active_last_draw = 0;
+    current_state.cursor_moved = 0;
+    current_state.board_past_x = 0;
+    current_state.board_past_y = 0;
+    current_state.en_passant_occured = 0;
+    current_state.castling_occured = 0;
 
+    reset_clock();
+    history_clear(&history);
+    repetition_clear(&game_keys, &current_state);
 
-uint8_t is_turn_valid(piece p, game_state g) {
-    if (is_move_valid(p, g)) {
-        g = move_and_possibly_take_piece(g);
-        if (check_in_check(g)) return 0;
-        else return 1;
-    }
-
-    return 0;
+    redraw_board();
 }
 
 
@@ -749,631 +843,629 @@ uint8_t is_turn_valid(piece p, game_state g) {
 
 
 
-uint8_t is_possible_move_for_piece(piece p, game_state g) {
-    uint8_t index = get_piece_index_in_game_state(p, g);
+rectangle get_square_rectangle(uint8_t x, uint8_t y) {
+    if (board_flipped) {
+        x = 7-x;
+        y = 7-y;
+    }
 
-    g.past_x = p.x;
-    g.past_y = p.y;
+    rectangle r = {40+x*TILESIZE, 40+x*TILESIZE+(TILESIZE-1), y*TILESIZE, y*TILESIZE+(TILESIZE-1)};
 
-    uint8_t i, j;
-    for (i=0; i<8; i++) {
-        for (j=0; j<8; j++) {
-            p.x = j;
-            p.y = i;
+    return r;
+}
 
-            g.pieces[index] = p;
+rectangle get_piece_rectangle_from_coords(uint8_t x, uint8_t y, game_state g) {
+    rectangle r = get_square_rectangle(x, y);
+    r.left += g.select.thickness;
+    r.right -= g.select.thickness;
+    r.top += g.select.thickness;
+    r.bottom -= g.select.thickness;
 
-            if (is_turn_valid(p, g)) {
-                return 1;
-            }
-        }
-    }
+    return r;
+}
 
-    return 0;
+rectangle get_hint_rectangle(uint8_t x, uint8_t y) {
+    rectangle r = get_square_rectangle(x, y);
+    r.left += 11;
+    r.right = r.left+8;
+    r.top += 11;
+    r.bottom = r.top+8;
+
+    return r;
+}
+
+void show_hint(uint8_t x, uint8_t y) {
+    hint_layer[y] |= _BV(x);
+    fill_rectangle(get_hint_rectangle(x, y), CYAN);
 }
 
-uint8_t are_there_possible_moves(game_state g) {
+void hide_hint(uint8_t x, uint8_t y, game_state g) {
+    rectangle r = get_hint_rectangle(x, y);
+    hint_layer[y] &= ~_BV(x);
+
+    // RESTORE ONLY THE DOT: FROM THE PIECE UNDER IT, OTHERWISE THE TILE COLOUR
     uint8_t i;
     for (i=0; i<32; i++) {
-        if (g.pieces[i].team==g.turn && g.pieces[i].taken==0) {
-            if (is_possible_move_for_piece(g.pieces[i], g)) {
-                return 1;
-            }
+        if (g.select.active && i==g.selected_piece_index) continue;
+        if (g.pieces[i].x==x && g.pieces[i].y==y && g.pieces[i].taken==0) {
+            draw_piece_region(g.pieces[i], r);
+            return;
         }
     }
 
-    return 0;
+    fill_rectangle(r, board[y*8+x].col);
 }
 
-move_set get_possible_moves_for_piece(piece p, game_state g) {
-    move_set m_s;
+void draw_possible_moves() {
+    uint8_t i;
 
-    uint8_t index = get_piece_index_in_game_state(p, g);
+    // ONLY DOTS NOT ALREADY ON SCREEN (E.G. WIPED BY A TILE REFRESH) ARE PAINTED
+    for (i=0; i<current_move_set.num_possible_moves; i++) {
+        uint8_t x = current_move_set.possible_moves_x[i];
+        uint8_t y = current_move_set.possible_moves_y[i];
+        if (!(hint_layer[y] & _BV(x))) show_hint(x, y);
+    }
+}
 
-    g.past_x = p.x;
-    g.past_y = p.y;
+void get_selector_rectangles(selector s, rectangle *r) {
+    // TOP AND BOTTOM BARS SPAN THE FULL WIDTH, THE SIDES FIT BETWEEN THEM
+    rectangle r1 = {s.r.left, s.r.right, s.r.top, s.r.top+s.thickness};
+    rectangle r2 = {s.r.left, s.r.right, s.r.bottom-s.thickness, s.r.bottom};
+    rectangle r3 = {s.r.left, s.r.left+s.thickness, s.r.top+s.thickness+1, s.r.bottom-s.thickness-1};
+    rectangle r4 = {s.r.right-s.thickness, s.r.right, s.r.top+s.thickness+1, s.r.bottom-s.thickness-1};
 
-    uint8_t counter = 0;
-    uint8_t i, j;
-    for (i=0; i<8; i++) {
-        for (j=0; j<8; j++) {
+    r[0] = r1;
+    r[1] = r2;
+    r[2] = r3;
+    r[3] = r4;
+}
 
-            p.x = j;
-            p.y = i;
+void draw_select(selector s) {
+    rectangle r[4];
+    get_selector_rectangles(s, r);
 
-            g.pieces[index] = p;
+    fill_rectangle(r[0], s.col);
+    fill_rectangle(r[1], s.col);
+    fill_rectangle(r[2], s.col);
+    fill_rectangle(r[3], s.col);
+}
 
-            if (is_turn_valid(p, g)) {
-                m_s.possible_moves_x[counter] = j;
-                m_s.possible_moves_y[counter] = i;
-                counter++;
-            }
-        }
-    }
+void draw_select_saving_under(selector s) {
+    rectangle frame[4];
+    get_selector_rectangles(s, frame);
+    save_under_capture(&select_under, frame, 4);
 
-    m_s.num_possible_moves = counter;
+    draw_select(s);
+}
 
-    return m_s;
+/* One blitter per (team, square colour): both colours are constants, so there
+   are no team or square tests. Each pixel is the top bit of the byte spread to
+   a 16-bit mask choosing between them, with no branch, then the byte shifts */
+#define PIECE_PIXEL(bits, b, fb)                                    \
+    write_data16((b) ^ ((fb) & -(uint16_t)((bits) >> 7)));          \
+    bits <<= 1;
+
+#define PIECE_BLITTER(name, fg, bg)                                 \
+void name(sprite *s) {                                              \
+    const uint16_t b = (bg);                                        \
+    const uint16_t fb = (fg) ^ (bg);                                \
+    const uint8_t *d = &s->data[0][0];                              \
+    uint8_t i, bits;                                                \
+    for (i=0; i<24*3; i++) {                                        \
+        bits = *d++;                                                \
+        PIECE_PIXEL(bits, b, fb)                                    \
+        PIECE_PIXEL(bits, b, fb)                                    \
+        PIECE_PIXEL(bits, b, fb)                                    \
+        PIECE_PIXEL(bits, b, fb)                                    \
+        PIECE_PIXEL(bits, b, fb)                                    \
+        PIECE_PIXEL(bits, b, fb)                                    \
+        PIECE_PIXEL(bits, b, fb)                                    \
+        PIECE_PIXEL(bits, b, fb)                                    \
+    }                                                               \
 }
 
+PIECE_BLITTER(blit_white_on_light, WHITE, LIGHT_BROWN)
+PIECE_BLITTER(blit_white_on_dark,  WHITE, DARK_BROWN)
+PIECE_BLITTER(blit_black_on_light, BLACK, LIGHT_BROWN)
+PIECE_BLITTER(blit_black_on_dark,  BLACK, DARK_BROWN)
 
+// Indexed by [team][(x+y)&1]: even squares are LIGHT_BROWN, odd are DARK_BROWN
+void (*const piece_blitters[2][2])(sprite *) = {
+    {blit_white_on_light, blit_white_on_dark},
+    {blit_black_on_light, blit_black_on_dark}
+};
 
+// Indexed by (type-1)%6
+sprite *const piece_sprites[6] = {&pawn, &rook, &knight, &bishop, &queen, &king};
 
+sprite *get_piece_sprite(piece p) {
+    // ONLY A PAWN WAITING TO PROMOTE STANDS ON THE LAST RANK
+    if (promotion_sprite && (p.type==1 || p.type==7) && (p.y==0 || p.y==7)) return promotion_sprite;
 
+    return piece_sprites[(p.type-1)%6];
+}
 
-uint8_t is_pawn_at_other_side() {
-    uint8_t i;
-    for (i=0; i<32; i++) {
-        if (current_state.pieces[i].team==0 && current_state.pieces[i].type==1 && current_state.pieces[i].y==0) return 1;
+void draw_piece(piece p) {
+    PROFILE_BEGIN(PROF_DRAW_PIECE);
+    rectangle r = get_piece_rectangle_from_coords(p.x, p.y, current_state);
 
-        if (current_state.pieces[i].team==1 && current_state.pieces[i].type==7 && current_state.pieces[i].y==7) return 1;
-    }
+    write_cmd(COLUMN_ADDRESS_SET);
+    write_data16(r.left);           // Left coord
+    write_data16(r.right);          // Right coord
+    write_cmd(PAGE_ADDRESS_SET);
+    write_data16(r.top);            // Top coord
+    write_data16(r.bottom);         // Bottom coord
+    write_cmd(MEMORY_WRITE);
 
-    return 0;
+    piece_blitters[p.team][(p.x+p.y)&1](get_piece_sprite(p));
+    PROFILE_END(PROF_DRAW_PIECE);
 }
 
-uint8_t get_index_of_pawn_at_other_side() {
-    uint8_t i;
-    for (i=0; i<32; i++) {
-        if (current_state.pieces[i].team==0 && current_state.pieces[i].type==1 && current_state.pieces[i].y==0) return i;
+void draw_piece_region(piece p, rectangle r) {
+    write_cmd(COLUMN_ADDRESS_SET);
+    write_data16(r.left);
+    write_data16(r.right);
+    write_cmd(PAGE_ADDRESS_SET);
+    write_data16(r.top);
+    write_data16(r.bottom);
+    write_cmd(MEMORY_WRITE);
 
-        if (current_state.pieces[i].team==1 && current_state.pieces[i].type==7 && current_state.pieces[i].y==7) return i;
+    uint16_t f = p.team ? BLACK : WHITE;
+    uint16_t b = ((p.x+p.y)&1) ? DARK_BROWN : LIGHT_BROWN;
+    rectangle a = get_piece_rectangle_from_coords(p.x, p.y, current_state);
+    sprite *s = get_piece_sprite(p);
+
+    // r MUST LIE INSIDE THE 24x24 SPRITE AREA a
+    uint8_t i, j;
+    for (i=r.top-a.top; i<=r.bottom-a.top; i++) {
+        for (j=r.left-a.left; j<=r.right-a.left; j++) {
+            write_data16((s->data[i][j>>3] & (0x80>>(j&7))) ? f : b);
+        }
     }
+}
 
-    return 0;
+void draw_tile(tile t) {
+    fill_rectangle(t.r, t.col);
 }
 
-void check_switches() {
-    cli();
+void draw_board(game_state g) {
+    // SQUARE -> PIECE INDEX+1, 0 WHEN EMPTY. A CARRIED PIECE IS DRAWN OVER WHAT IT HOVERS ON
+    uint8_t occupancy[64] = {0};
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g.pieces[i].taken==0 && !(g.select.active && i==g.selected_piece_index)) occupancy[g.pieces[i].y*8+g.pieces[i].x] = i+1;
+    }
+    if (g.select.active) occupancy[g.select.y*8+g.select.x] = g.selected_piece_index+1;
 
-    if (is_pawn_at_other_side() && current_state.select.active==0) { // STALL ALL OTHER INPUT CHANGES UNTIL PAWN NO LONGER AT OTHER SIDE
-        uint8_t index = get_index_of_pawn_at_other_side();
-        uint8_t team = current_state.pieces[index].team;
-        current_state.select.x = current_state.pieces[index].x;
-        current_state.select.y = current_state.pieces[index].y;
-        current_state.select.col = MAGENTA;
-        current_state.select.active = 0;
+    write_cmd(COLUMN_ADDRESS_SET);
+    write_data16(40);
+    write_data16(40+8*TILESIZE-1);
+    write_cmd(PAGE_ADDRESS_SET);
+    write_data16(0);
+    write_data16(8*TILESIZE-1);
+    write_cmd(MEMORY_WRITE);
 
-        if (get_switch_press(_BV(SWE))) {
-            current_state.pieces[index].s = &queen;
-            current_state.board_past_x = current_state.select.x;
-            current_state.board_past_y = current_state.select.y;
-            current_state.has_drawn = 0;
+    uint8_t row, sx, k;
+    for (row=0; row<8*TILESIZE; row++) {
+        uint8_t sy = row/TILESIZE;
+        uint8_t py = row%TILESIZE;
+        uint8_t sprite_row = (py>=g.select.thickness && py<g.select.thickness+24);
+
+        for (sx=0; sx<8; sx++) {
+            uint8_t x = board_flipped ? 7-sx : sx;
+            uint8_t y = board_flipped ? 7-sy : sy;
+            uint16_t b = ((x+y)&1) ? DARK_BROWN : LIGHT_BROWN;
+            uint8_t o = occupancy[y*8+x];
+
+            if (o && sprite_row) {
+                piece p = g.pieces[o-1];
+                uint16_t f = p.team ? BLACK : WHITE;
+                uint8_t *d = get_piece_sprite(p)->data[py-g.select.thickness];
+
+                for (k=0; k<g.select.thickness; k++) write_data16(b);
+                for (k=0; k<24; k++) write_data16((d[k>>3] & (0x80>>(k&7))) ? f : b);
+                for (k=g.select.thickness+24; k<TILESIZE; k++) write_data16(b);
+            } else {
+                for (k=0; k<TILESIZE; k++) write_data16(b);
+            }
         }
+    }
+}
 
-        if (get_switch_press(_BV(SWW))) {
-            current_state.pieces[index].s = &knight;
-            current_state.board_past_x = current_state.select.x;
-            current_state.board_past_y = current_state.select.y;
-            current_state.has_drawn = 0;
-        }
 
-        if (get_switch_press(_BV(SWC))) {
-            if (current_state.pieces[index].s==&knight) {
-                if (team) {
-                    current_state.pieces[index].type = 9;
-                } else {
-                    current_state.pieces[index].type = 3;
-                }
 
-                current_state.board_past_x = current_state.select.x;
-                current_state.board_past_y = current_state.select.y;
-                current_state.has_drawn = 0;
-                current_state.select.active = 0;
 
-                update_selected();
-            } else if (current_state.pieces[index].s==&queen) {
-                if (team) {
-                    current_state.pieces[index].type = 11;
-                } else {
-                    current_state.pieces[index].type = 5;
-                }
 
-                current_state.board_past_x = current_state.select.x;
-                current_state.board_past_y = current_state.select.y;
-                current_state.has_drawn = 0;
-                current_state.select.active = 0;
 
-                update_selected();
-            }
+void refresh_tile(uint8_t x, uint8_t y, game_state g) {
+    PROFILE_BEGIN(PROF_REFRESH_TILE);
+    rectangle r = get_square_rectangle(x, y);
+    tile t;
+    t.r = r;
+    if (y%2==0) {
+        if (x%2==0) {
+            t.col = LIGHT_BROWN; // Light brown instead of white
+        } else {
+            t.col = DARK_BROWN; // Dark brown instead of black
         }
     } else {
-        if (get_switch_press(_BV(SWE))) {
-            if (current_state.select.x<7) {
-                current_state.select.r.left += TILESIZE;
-                current_state.select.r.right += TILESIZE;
-                current_state.select.x++;
-
-                if (current_state.select.x>0) {
-                    current_state.board_past_x = current_state.select.x-1;
-                    current_state.board_past_y = current_state.select.y;
-                } else {
-                    current_state.board_past_x = current_state.select.x;
-                    current_state.board_past_y = current_state.select.y;
-                }
-                current_state.has_drawn = 0;
-            }
-        }
-
-        if (get_switch_press(_BV(SWW))) {
-            if (current_state.select.x>0) {
-                current_state.select.r.left -= TILESIZE;
-                current_state.select.r.right -= TILESIZE;
-                current_state.select.x--;
-
-                if (current_state.select.x<7) {
-                    current_state.board_past_x = current_state.select.x+1;
-                    current_state.board_past_y = current_state.select.y;
-                } else {
-                    current_state.board_past_x = current_state.select.x;
-                    current_state.board_past_y = current_state.select.y;
-                }
-                current_state.has_drawn = 0;
-            }
-        }
-
-        if (get_switch_press(_BV(SWS))) {
-            if (current_state.select.y<7) {
-                current_state.select.r.top += TILESIZE;
-                current_state.select.r.bottom += TILESIZE;
-                current_state.select.y++;
-                    
-                if (current_state.select.y>0) {
-                    current_state.board_past_x = current_state.select.x;
-                    current_state.board_past_y = current_state.select.y-1;
-                } else {
-                    current_state.board_past_x = current_state.select.x;
-                    current_state.board_past_y = current_state.select.y;
-                }
-                current_state.has_drawn = 0;
-            }
-        }
-
-        if (get_switch_press(_BV(SWN))) {
-            if (current_state.select.y>0) {
-                current_state.select.r.top -= TILESIZE;
-                current_state.select.r.bottom -= TILESIZE;
-                current_state.select.y--;
-
-                if (current_state.select.y<7) {
-                    current_state.board_past_x = current_state.select.x;
-                    current_state.board_past_y = current_state.select.y+1;
-                } else {
-                    current_state.board_past_x = current_state.select.x;
-                    current_state.board_past_y = current_state.select.y;
-                }
-                current_state.has_drawn = 0;
-            }
+        if (x%2==0) {
+            t.col = DARK_BROWN;
+        } else {
+            t.col = LIGHT_BROWN;
         }
+    }
 
-        update_selected();
-
-        if (get_switch_press(_BV(SWC))) {
-            if (current_state.select.active==1) {
-                if (current_state.pieces[current_state.selected_piece_index].x==current_state.past_x && current_state.pieces[current_state.selected_piece_index].y==current_state.past_y) {
-                    update_selected();
-                    current_state.board_past_x = current_state.select.x;
-                    current_state.board_past_y = current_state.select.y;
-                    current_state.has_drawn = 0;
-                    current_state.select.active = 0;
-                } else {
-                    if (is_turn_valid(current_state.pieces[current_state.selected_piece_index], current_state)) {
-                        current_state = move_and_possibly_take_piece(current_state);
-                        change_turn();
-                    }
-                }
-            } else {
-                uint8_t i;
-                for (i=0; i<32; i++) {
-                    if (current_state.pieces[i].x==current_state.select.x && current_state.pieces[i].y==current_state.select.y && current_state.pieces[i].team==current_state.turn && current_state.pieces[i].taken==0) {
-                        current_state.selected_piece_index = i;
-                        current_state.select.active = 1;
-                        current_state.past_x = current_state.select.x;
-                        current_state.past_y = current_state.select.y;
-                        break;
-                    }
-                }
-
-                if (current_state.select.active) {
-                    current_state.board_past_x = current_state.select.x;
-                    current_state.board_past_y = current_state.select.y;
-                    current_state.has_drawn = 0;
-                    current_move_set = get_possible_moves_for_piece(current_state.pieces[current_state.selected_piece_index], current_state);
-                }
-            }
-        }
+    draw_tile(t);
+    hint_layer[y] &= ~_BV(x);
 
-        update_selected();
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g.select.active) {
+            if (i!=g.selected_piece_index && g.pieces[i].x==x && g.pieces[i].y==y && g.pieces[i].taken==0) draw_piece(g.pieces[i]);
+        } else if (g.pieces[i].x==x && g.pieces[i].y==y && g.pieces[i].taken==0) draw_piece(g.pieces[i]);
     }
-
-    sei();
+    PROFILE_END(PROF_REFRESH_TILE);
 }
 
+void draw_over_potential_moves(move_set m_s, game_state g) {
+    uint8_t i;
+    for (i=0; i<m_s.num_possible_moves; i++) {
+        uint8_t x = m_s.possible_moves_x[i];
+        uint8_t y = m_s.possible_moves_y[i];
+        if (hint_layer[y] & _BV(x)) hide_hint(x, y, g);
+    }
+}
 
+void refresh_en_passant_tile(game_state g) {
+    refresh_tile(g.en_passant_x, g.en_passant_y, g);
+}
 
-
-
-void change_turn() {
-    if (current_state.turn) current_state.turn = 0;
-    else current_state.turn = 1;
+void refresh_castling_tile(game_state g) {
+    refresh_tile(0, g.board_past_y, g);
+    refresh_tile(7, g.board_past_y, g);
 }
 
 
 
 
 
-rectangle get_rectangle_for_selector() {
-    rectangle r;
-    r.left = current_state.select.r.left+current_state.select.thickness;
-    r.right = current_state.select.r.right-current_state.select.thickness;
-    r.top = current_state.select.r.top+current_state.select.thickness;
-    r.bottom = current_state.select.r.bottom-current_state.select.thickness;
 
-    return r;
+void open_menu() {
+    menu_open = 1;
+    menu_index = 0;
+    menu_page_open = 0;
+    menu_dirty = MENU_DIRTY_ALL;
 }
 
-void update_selected() {
-    if (current_state.select.active) {
-        if ((is_turn_valid(current_state.pieces[current_state.selected_piece_index], current_state)) || 
-            (current_state.pieces[current_state.selected_piece_index].x==current_state.past_x && current_state.pieces[current_state.selected_piece_index].y==current_state.past_y)) {
-            current_state.select.col = 0x07FF; // CYAN
-        } else {
-            current_state.select.col = 0xF800; // RED
-        }
+void close_menu() {
+    // THE BOARD UNDERNEATH WAS PAINTED OVER
+    menu_open = 0;
+    menu_page_open = 0;
+    full_redraw_pending = 1;
+    current_state.has_drawn = 0;
+}
 
-        current_state.pieces[current_state.selected_piece_index].r = get_rectangle_for_selector(current_state.pieces[current_state.selected_piece_index]);
-        current_state.pieces[current_state.selected_piece_index].x = current_state.select.x;
-        current_state.pieces[current_state.selected_piece_index].y = current_state.select.y;
-    } else {
-        uint8_t i;
-        for (i=0; i<32; i++) {
-            if (current_state.pieces[i].x==current_state.select.x && current_state.pieces[i].y==current_state.select.y && current_state.pieces[i].team==current_state.turn && current_state.pieces[i].taken==0) {
-                current_state.select.col = 0x07E0; // GREEN
-                return;
-            }
+void handle_menu_event(switch_event e) {
+    if (menu_page_open) {
+        if (e.type!=SWITCH_PRESS) return;
+        if (e.switches==_BV(SWC)) {
+            menu_dirty = MENU_DIRTY_ALL; // REDRAW WITH FRESH NUMBERS
+        } else {
+            menu_page_open = 0;
+            menu_dirty = MENU_DIRTY_ALL;
         }
-
-        current_state.select.col = 0xFFE0; // YELLOW
+        return;
     }
-}
-
-
 
+    if (e.type==SWITCH_LONG) return;
 
+    if (e.switches==_BV(SWN)) {
+        menu_index = (menu_index + MENU_ITEMS - 1) % MENU_ITEMS;
+        menu_dirty = MENU_DIRTY_LABELS;
+    }
+    if (e.switches==_BV(SWS)) {
+        menu_index = (menu_index + 1) % MENU_ITEMS;
+        menu_dirty = MENU_DIRTY_LABELS;
+    }
 
+    if (e.type!=SWITCH_PRESS) return;
 
-void create_board() {
-    uint8_t i;
-    /* Create Tiles */
-    for (i=0; i<64; i++) {
-        rectangle r = {40+(i%8)*TILESIZE,40+((i%8)*TILESIZE)+(TILESIZE-1),(int)(i/8)*TILESIZE,((int)(i/8)*TILESIZE)+(TILESIZE-1)};
-        tile t;
-        t.r = r;
-        if (i/8%2==0) {
-            if (i%2==0) {
-                t.col = LIGHT_BROWN; // Light brown instead of white
-                board[i] = t;
-            } else {
-                t.col = DARK_BROWN; // Dark brown instead of black
-                board[i] = t;
-            }
+    if (e.switches==_BV(SWC)) {
+        if (menu_items[menu_index].page) {
+            menu_page_open = 1;
+            menu_dirty = MENU_DIRTY_ALL;
         } else {
-            if (i%2==0) {
-                t.col = DARK_BROWN;
-                board[i] = t;
-            } else {
-                t.col = LIGHT_BROWN;
-                board[i] = t;
-            }
+            menu_items[menu_index].action();
         }
     }
+    if (e.switches==_BV(SWW)) close_menu();
 }
 
-void create_pieces() {
-    uint8_t i;
+void menu_flip_board() {
+    close_menu();
+    flip_board();
+}
 
-    // Type (WHITE): 1 (Pawn), 2 (Rook), 3 (Knight), 4 (Bishop), 5 (Queen), 6 (King)
-    // Type (BLACK): 7 (Pawn), 8 (Rook), 9 (Knight),10 (Bishop),11 (Queen),12 (King)
+void draw_menu() {
+    if (menu_dirty==MENU_DIRTY_ALL) {
+        rectangle r = {40, 40+8*TILESIZE-1, 0, 8*TILESIZE-1};
+        fill_rectangle(r, BLACK);
+    }
 
-    // TODO CREATE CORRECT PIECES AND PLACE THEM CORRECTLY
-    // Create pieces
-    for (i=0; i<32; i++) {
-        piece p;
-        
-        if (i/16==0) {
-            rectangle r = {40+(i%8)*TILESIZE+current_state.select.thickness,40+((i%8)*TILESIZE)+(TILESIZE-1)-current_state.select.thickness,(int)(i/8)*TILESIZE+current_state.select.thickness,((int)(i/8)*TILESIZE)+(TILESIZE-1)-current_state.select.thickness};
-
-            p.r = r;
-            p.x = (i%8);
-            p.y = (i/8);
-            p.taken = 0;
-            p.first = 1; // TRUE
-            p.team = 1;
-            if (i==0 || i==7) {
-                p.type = 8;
-                p.s = &rook;
-            } else if (i==1 || i==6) { 
-                p.type = 9;
-                p.s = &knight;
-            } else if (i==2 || i==5) { 
-                p.type = 10;
-                p.s = &bishop;
-            } else if (i==3) {
-                p.type = 11;
-                p.s = &queen;
-            } else if (i==4) {
-                p.type = 12;
-                p.s = &king;
-            } else {
-                p.type = 7;
-                p.s = &pawn;
-            }
-        } else {
-            rectangle r = {40+(i%8)*TILESIZE+current_state.select.thickness,40+((i%8)*TILESIZE)+(TILESIZE-1)-current_state.select.thickness,((int)(9-(i/8))*TILESIZE+current_state.select.thickness),(((int)(9-(i/8))*TILESIZE)+(TILESIZE-1)-current_state.select.thickness)};
-            
-            p.r = r;
-            p.x = (i%8);
-            p.y = 9-(i/8);
-            p.taken = 0;
-            p.first = 1; // TRUE
-            p.team = 0;
-            if (i==16 || i==23) {
-                p.type = 2;
-                p.s = &rook;
-            } else if (i==17 || i==22) { 
-                p.type = 3;
-                p.s = &knight;
-            } else if (i==18 || i==21) { 
-                p.type = 4;
-                p.s = &bishop;
-            } else if (i==19) {
-                p.type = 5;
-                p.s = &queen;
-            } else if (i==20) {
-                p.type = 6;
-                p.s = &king;
-            } else {
-                p.type = 1;
-                p.s = &pawn;
-            }
+    if (menu_page_open) {
+        menu_items[menu_index].page();
+    } else {
+        // LABELS ARE REDRAWN IN PLACE, ONLY THEIR COLOUR CHANGES
+        uint8_t i;
+        for (i=0; i<MENU_ITEMS; i++) {
+            display.foreground = i==menu_index ? YELLOW : WHITE;
+            display_string_xy(menu_items[i].label, MENU_LEFT, MENU_TOP + i*MENU_LINE);
         }
-        
-        current_state.pieces[i] = p;
+        display.foreground = WHITE;
     }
-}
 
-void create_selector() {
-    /* Create Selector */
-    current_state.select.r.left = 40;
-    current_state.select.r.right = 69;
-    current_state.select.r.top = 0;
-    current_state.select.r.bottom = 29;
-    current_state.select.thickness = 3;
-    current_state.select.col = 0x07E0;
-    current_state.select.x = 0;
-    current_state.select.y = 0;
-    current_state.select.active = 0;
+    menu_dirty = MENU_DIRTY_NONE;
 }
 
-void first_draw() {
+void draw_profile_page() {
+#ifdef PROFILE
+    char line[41];
     uint8_t i;
-    for (i=0; i<64; i++) draw_tile(board[i]);
-    for (i=0; i<32; i++)
-        draw_piece(current_state.pieces[i]);
-    
-    draw_select(current_state.select);
+
+    display_string_xy("SECTION     CALLS    MIN    AVG    MAX", MENU_LEFT, MENU_TOP);
+    for (i=0; i<PROF_SECTIONS; i++) {
+        sprintf(line, "%-12s%5u%7lu%7lu%7lu", profile_names[i], profile_entries[i].calls,
+                (unsigned long)profile_entries[i].min * PROFILE_US_PER_TICK,
+                (unsigned long)profile_average(i) * PROFILE_US_PER_TICK,
+                (unsigned long)profile_entries[i].max * PROFILE_US_PER_TICK);
+        display_string_xy(line, MENU_LEFT, MENU_TOP + (i+1)*MENU_LINE);
+    }
+    display_string_xy("TIMES IN US, CENTRE REFRESHES", MENU_LEFT, MENU_TOP + (PROF_SECTIONS+2)*MENU_LINE);
+#else
+    display_string_xy("BUILD WITH -DPROFILE", MENU_LEFT, MENU_TOP);
+#endif
+}
+void draw_latency_page() {
+    char line[41];
+    uint8_t i;
+
+    sprintf(line, "SAMPLES %u", latency.samples);
+    display_string_xy(line, MENU_LEFT, MENU_TOP);
+    sprintf(line, "P50 %lu US  P99 %lu US",
+            (unsigned long)latency_percentile(50) * PROFILE_US_PER_TICK,
+            (unsigned long)latency_percentile(99) * PROFILE_US_PER_TICK);
+    display_string_xy(line, MENU_LEFT, MENU_TOP + MENU_LINE);
+    sprintf(line, "MAX %lu US", (unsigned long)latency.max * PROFILE_US_PER_TICK);
+    display_string_xy(line, MENU_LEFT, MENU_TOP + 2*MENU_LINE);
+
+    // ONE BAR PER 4MS BUCKET, THE LAST ONE IS EVERYTHING SLOWER
+    uint16_t tallest = 1;
+    for (i=0; i<=LATENCY_BUCKETS; i++) {
+        if (latency.counts[i] > tallest) tallest = latency.counts[i];
+    }
+    for (i=0; i<=LATENCY_BUCKETS; i++) {
+        uint16_t h = (uint32_t)latency.counts[i] * LATENCY_BAR_HEIGHT / tallest;
+        if (h==0) continue;
+        rectangle r = {MENU_LEFT + i*6, MENU_LEFT + i*6 + 4, LATENCY_BAR_BOTTOM - h + 1, LATENCY_BAR_BOTTOM};
+        fill_rectangle(r, i<LATENCY_BUCKETS ? GREEN : RED);
+    }
+    display_string_xy("0", MENU_LEFT, LATENCY_BAR_BOTTOM + 4);
+    display_string_xy("64MS", MENU_LEFT + 16*6, LATENCY_BAR_BOTTOM + 4);
+}
+void menu_next_time_control() {
+    // TAKES EFFECT IMMEDIATELY, BOTH CLOCKS START AGAIN
+    time_control_index = (time_control_index + 1) % TIME_CONTROLS;
+    reset_clock();
+    close_menu();
 }
 
-void init_game() {
-    create_board();
+void menu_undo() {
+    close_menu();
+    undo_move();
+}
 
-    create_selector();  
+void menu_redo() {
+    close_menu();
+    redo_move();
+}
 
-    // SELECTOR THICKNESS NEEDED TO MAKE PIECES
-    create_pieces();
+void menu_export_pgn() {
+    // THE GAME SO FAR GOES OUT THROUGH THE UART (STDOUT ON THE HOST), ONE CHUNK AT A TIME
+    pgn_sink sink;
+    close_menu();
+#ifdef __AVR__
+    pgn_serial_open(&sink);
+    pgn_write_game(&sink, current_state, &history);
+    pgn_serial_close(&sink);
+#else
+    pgn_file_open(&sink, stdout);
+    pgn_write_game(&sink, current_state, &history);
+#endif
+}
 
-    current_state.turn = 0; 
+void menu_load_position() {
+    // EACH USE LOADS THE NEXT STORED POSITION, THE LAST ONE IS THE START
+    close_menu();
+    load_position(pgm_read_ptr(&positions[position_index]));
+    position_index = (position_index + 1) % POSITIONS;
+}
 
-    current_state.selected_piece_index = 0; 
+void load_position(PGM_P fen) {
+    char buffer[FEN_MAX];
+    strncpy_P(buffer, fen, FEN_MAX - 1);
+    buffer[FEN_MAX - 1] = '\0';
+    if (set_position(buffer)) save_begin(&game_save, buffer, 0);
+}
 
-    current_state.can_en_passant = 0;
+uint8_t set_position(char *fen) {
+    if (!fen_read(fen, &current_state)) return 0;
 
+    current_state.select.active = 0;
     current_state.select_active_last_draw = 0;
-    current_state.board_past_x = 0;
-    current_state.board_past_y = 0;
     current_state.en_passant_occured = 0;
     current_state.castling_occured = 0;
+    update_selected();
+
+    history_clear(&history);
+    repetition_clear(&game_keys, &current_state);
+    reset_clock();
+    clear_result();
 
-    first_draw();
+    full_redraw_pending = 1;
+    current_state.has_drawn = 0;
+    return 1;
 }
 
+void resume_game() {
+    // CARRY ON WITH THE GAME IN EEPROM, REPLAYING ITS MOVES WHILE THEY CHECK OUT
+    char fen[FEN_MAX];
+    save_init(&game_save);
+    if (!save_find(&game_save, fen) || !set_position(fen)) {
+        fen_write(&current_state, fen);
+        save_begin(&game_save, fen, 0);
+        return;
+    }
 
+    packed_move m;
+    while (save_record(&game_save, history.current, &m) && is_legal_move(current_state, m)) {
+        undo_record u;
+        replay_move(m, &u);
+        history_push(&history, m, u);
+    }
 
+    current_state.select.active = 0;
+    move_selector_to(current_state.select.x, current_state.select.y);
+    update_selected();
+}
 
+void follow_uci_position() {
+    // THE BOARD SHOWS WHATEVER THE GUI LAST SET UP, AND THAT BECOMES THE SAVED GAME
+    char fen[FEN_MAX];
+    uci.position_changed = 0;
+    fen_write(&uci.position, fen);
+    if (set_position(fen)) {
+        save_begin(&game_save, fen, 0);
+        game_keys = uci.keys; // THE GUI'S MOVES COUNT TOWARDS A REPETITION
+    }
+}
 
+void draw_cpu_page() {
+    char line[41];
 
-void draw_possible_moves() {
-    uint8_t i;
+    sprintf(line, "BUSY %u.%u%% OF THE LAST SECOND", busy_permille/10, busy_permille%10);
+    display_string_xy(line, MENU_LEFT, MENU_TOP);
+    display_string_xy("IDLE SLEEP BETWEEN EVENTS", MENU_LEFT, MENU_TOP + MENU_LINE);
+}
 
-    for (i=0; i<current_move_set.num_possible_moves; i++) {
-        rectangle r = {40+(30*current_move_set.possible_moves_x[i])+11, 40+(30*current_move_set.possible_moves_x[i])+19, (30*current_move_set.possible_moves_y[i])+11, (30*current_move_set.possible_moves_y[i])+19};
-        fill_rectangle(r, CYAN);
-    }
+void draw_memory_page() {
+    char line[41];
+    memory_usage m;
+    memory_read(&m);
+
+    sprintf(line, "DATA  %5u BYTES", m.data);
+    display_string_xy(line, MENU_LEFT, MENU_TOP);
+    sprintf(line, "BSS   %5u BYTES", m.bss);
+    display_string_xy(line, MENU_LEFT, MENU_TOP + MENU_LINE);
+    sprintf(line, "HEAP  %5u BYTES", m.heap);
+    display_string_xy(line, MENU_LEFT, MENU_TOP + 2*MENU_LINE);
+    sprintf(line, "STACK %5u NOW, %u DEEPEST", m.stack, m.stack_deepest);
+    display_string_xy(line, MENU_LEFT, MENU_TOP + 3*MENU_LINE);
+    sprintf(line, "NEVER USED %u OF %u", m.never_used, MEMORY_SRAM);
+    display_string_xy(line, MENU_LEFT, MENU_TOP + 5*MENU_LINE);
+    display_string_xy("DEEPEST IS SINCE RESET", MENU_LEFT, MENU_TOP + 6*MENU_LINE);
 }
 
-void draw_select(selector s) {
-    rectangle r1 = {s.r.left, s.r.right, s.r.top, s.r.top+s.thickness};
-    rectangle r2 = {s.r.left, s.r.right, s.r.bottom-s.thickness, s.r.bottom};
-    rectangle r3 = {s.r.left, s.r.left+s.thickness, s.r.top, s.r.bottom};
-    rectangle r4 = {s.r.right-s.thickness, s.r.right, s.r.top, s.r.bottom};
 
-    fill_rectangle(r1, s.col);
-    fill_rectangle(r2, s.col);
-    fill_rectangle(r3, s.col);
-    fill_rectangle(r4, s.col);
+
+
+
+
+void load_clock_glyphs() {
+    uint8_t i;
+    for (i=0; i<10; i++) load_glyph(&clock_glyphs[i], '0'+i);
+    load_glyph(&clock_glyphs[10], ':');
 }
 
-void draw_piece(piece p) {
-    write_cmd(COLUMN_ADDRESS_SET);
-    write_data16(p.r.left);         // Left coord
-    write_data16(p.r.right);        // Right coord
-    write_cmd(PAGE_ADDRESS_SET);
-    write_data16(p.r.top);          // Top coord
-    write_data16(p.r.bottom);       // Bottom coord
-    write_cmd(MEMORY_WRITE);
+void reset_clock() {
+    time_control tc = time_controls[time_control_index];
+    clock_init(&game_clock, tc.seconds, tc.increment, tc.mode);
 
-    uint8_t i, j, k;
-    
-    if (p.y%2==0) {
-        if (p.x%2==0) {
-            // DARK_BROWN
-            for (i=0; i<24; i++) {
-                for (j=0; j<3;j++) {
-                    for (k=0; k<8; k++) {
-                        uint8_t val = (uint8_t)((p.s->data[i][j])<<k) & 0x80;
-                        if (val) {
-                            if (p.team) {
-                                write_data16(0x0000);
-                            } else {
-                                write_data16(0xFFFF);
-                            }
-                        } else {
-                            write_data16(LIGHT_BROWN);
-                        }
-                    }
-                }
-            }
-        } else {
-            // LIGHT_BROWN
-            for (i=0; i<24; i++) {
-                for (j=0; j<3;j++) {
-                    for (k=0; k<8; k++) {
-                        uint8_t val = (uint8_t)((p.s->data[i][j])<<k) & 0x80;
-                        if (val) {
-                            if (p.team) {
-                                write_data16(0x0000);
-                            } else {
-                                write_data16(0xFFFF);
-                            }
-                        } else {
-                            write_data16(DARK_BROWN);
-                        }
-                    }
-                }
-            }
-        }
-    } else {
-        if (p.x%2==0) {
-            // LIGHT_BROWN
-            for (i=0; i<24; i++) {
-                for (j=0; j<3;j++) {
-                    for (k=0; k<8; k++) {
-                        uint8_t val = (uint8_t)((p.s->data[i][j])<<k) & 0x80;
-                        if (val) {
-                            if (p.team) {
-                                write_data16(0x0000);
-                            } else {
-                                write_data16(0xFFFF);
-                            }
-                        } else {
-                            write_data16(DARK_BROWN);
-                        }
-                    }
-                }
-            }
-        } else {
-            // DARK_BROWN
-            for (i=0; i<24; i++) {
-                for (j=0; j<3;j++) {
-                    for (k=0; k<8; k++) {
-                        uint8_t val = (uint8_t)((p.s->data[i][j])<<k) & 0x80;
-                        if (val) {
-                            if (p.team) {
-                                write_data16(0x0000);
-                            } else {
-                                write_data16(0xFFFF);
-                            }
-                        } else {
-                            write_data16(LIGHT_BROWN);
-                        }
-                    }
-                }
-            }
-        }
+    // NOTHING MATCHES, SO THE NEXT draw_clocks DRAWS EVERY CHARACTER
+    uint8_t i;
+    for (i=0; i<5; i++) {
+        clock_shown[0][i] = 0;
+        clock_shown[1][i] = 0;
     }
-}
 
-void draw_tile(tile t) {
-    fill_rectangle(t.r, t.col);
+    if (tc.seconds==0) {
+        rectangle r = {CLOCK_WHITE_X, CLOCK_WHITE_X+5*6-1, CLOCK_Y, CLOCK_Y+7};
+        fill_rectangle(r, BLACK);
+        r.left = CLOCK_BLACK_X;
+        r.right = CLOCK_BLACK_X+5*6-1;
+        fill_rectangle(r, BLACK);
+    }
 }
 
+void draw_clocks() {
+    if (time_controls[time_control_index].seconds==0) return;
 
+    uint32_t now = profile_now();
+    uint8_t side;
+    for (side=0; side<2; side++) {
+        // ROUNDED UP, SO 0:00 ONLY SHOWS ONCE THE FLAG HAS FALLEN
+        uint32_t left = clock_remaining(&game_clock, side, now);
+        uint16_t secs = (left + CLOCK_TICKS_PER_SECOND - 1) / CLOCK_TICKS_PER_SECOND;
+        uint8_t mins = secs / 60 > 99 ? 99 : secs / 60;
+        char text[5] = {'0' + mins/10, '0' + mins%10, ':', '0' + (secs%60)/10, '0' + secs%10};
 
+        uint16_t col = CLOCK_IDLE_COL;
+        if (game_clock.flagged==side+1) col = RED;
+        else if (game_clock.running && game_clock.side==side) col = WHITE;
 
+        draw_clock_text(side, text, col);
+    }
+}
 
+void draw_clock_text(uint8_t side, char *text, uint16_t col) {
+    uint16_t x = side ? CLOCK_BLACK_X : CLOCK_WHITE_X;
+    uint8_t i;
 
-void refresh_tile(uint8_t x, uint8_t y, game_state g) {
-    rectangle r = {40+(x*TILESIZE),40+(x*TILESIZE)+(TILESIZE-1),y*TILESIZE,(y*TILESIZE)+(TILESIZE-1)};
-    tile t;
-    t.r = r;
-    if (y%2==0) {
-        if (x%2==0) {
-            t.col = LIGHT_BROWN; // Light brown instead of white
-        } else {
-            t.col = DARK_BROWN; // Dark brown instead of black
-        }
-    } else {
-        if (x%2==0) {
-            t.col = DARK_BROWN;
-        } else {
-            t.col = LIGHT_BROWN;
-        }
+    display.foreground = col;
+    for (i=0; i<5; i++) {
+        if (text[i]==clock_shown[side][i] && col==clock_shown_col[side]) continue;
+        draw_glyph(&clock_glyphs[text[i]==':' ? 10 : text[i]-'0'], x + i*6, CLOCK_Y);
+        clock_shown[side][i] = text[i];
     }
+    clock_shown_col[side] = col;
+    display.foreground = WHITE;
+}
 
-    draw_tile(t);
 
-    uint8_t i;
-    for (i=0; i<32; i++) {
-        if (g.select.active) {
-            if (i!=g.selected_piece_index && g.pieces[i].x==x && g.pieces[i].y==y && g.pieces[i].taken==0) draw_piece(g.pieces[i]);
-        } else if (g.pieces[i].x==x && g.pieces[i].y==y && g.pieces[i].taken==0) draw_piece(g.pieces[i]);
+
+
+
+
+void sleep_until_event() {
+    uint32_t now = profile_now();
+    if (now - busy_window_start >= PROFILE_TICKS_PER_SECOND) {
+        busy_permille = 1000 - idle_ticks*1000 / (now - busy_window_start);
+        busy_window_start = now;
+        idle_ticks = 0;
     }
-}
 
-void draw_over_potential_moves(move_set m_s, game_state g) {
-    uint8_t i;
-    for (i=0; i<m_s.num_possible_moves; i++) {
-        refresh_tile(m_s.possible_moves_x[i], m_s.possible_moves_y[i], g);
+    // CHECK AND SLEEP WITH INTERRUPTS OFF, OR AN EVENT ARRIVING IN BETWEEN WOULD WAIT FOR THE NEXT WAKE-UP
+    cli();
+    uint8_t work = switch_events_pending() || rotary || uart_rx_pending() || (menu_open ? menu_dirty : current_state.has_drawn==0);
+    if (work) {
+        sei();
+        return;
     }
-}
 
-void refresh_en_passant_tile(game_state g) {
-    refresh_tile(g.en_passant_x, g.en_passant_y, g);
-}
+    // WOKEN BY THE SWITCH SCAN (TIMER 1), THE WHEEL (INT4/5), TE (INT6), USART1 OR TIMER 3
+    hal_idle();
 
-void refresh_castling_tile(game_state g) {
-    refresh_tile(0, g.board_past_y, g);
-    refresh_tile(7, g.board_past_y, g);
+    idle_ticks += profile_now() - now;
 }
 
 
@@ -1382,51 +1474,45 @@ void refresh_castling_tile(game_state g) {
 
 
 int main() {
-    /* Clear DIV8 to get 8MHz clock */
-	CLKPR = (1 << CLKPCE);
-	CLKPR = 0;
+    /* Clock, timers and interrupt sources */
+    hal_init();
 
     init_lcd();
+    load_clock_glyphs();
     init_buttons();
+    init_rotary();
     set_frame_rate_hz(50);
-
-    /* Enable tearing interrupt to get flicker free display */
-    EIMSK |= _BV(INT6);
-
-    /* Enable rotary interrupt to respond to input */
-	EIMSK |= _BV(INT4) | _BV(INT5);
-
-    /* Enable timer (Timer 1 CTC Mode 4) */
-	TCCR1A = 0;
-	TCCR1B = _BV(WGM12);
-	TCCR1B |= _BV(CS10);
-	TIMSK1 |= _BV(OCIE1A);
-    OCR1A = 65535;
-
-    /* Enable performance counter (Timer 3 CTC Mode 4) */
-	TCCR3A = 0;
-	TCCR3B = _BV(WGM32);
-	TCCR3B |= _BV(CS32);
-	TIMSK3 |= _BV(OCIE3A);
-	OCR3A = 31250;
+    uart_init();
     
 
     current_state.has_drawn = 0;
     
     init_game();
+    resume_game();
+    uci_init(&uci);
 
     // Enable interrupts */
     sei();
 
     uint8_t checkmate_state;
+    uint8_t draw_state;
+    uint8_t promotion_pending;
     do {
-        // Spin wheels for time being
+        sleep_until_event();
         check_switches();
-
-        if (current_state.has_drawn==0) {
-            checkmate_state = check_checkmate(current_state);
+        uci_poll(&uci);
+        if (uci.position_changed) follow_uci_position();
+        draw_clocks();
+
+        if (menu_open) {
+            if (menu_dirty) draw_menu();
+        } else if (current_state.has_drawn==0) {
+            // NO RESULT WHILE A PAWN WAITS FOR ITS PROMOTION PIECE
+            promotion_pending = is_pawn_at_other_side() && current_state.select.active==0;
+            checkmate_state = promotion_pending ? 0 : check_checkmate(current_state);
             //checkmate_state = check_in_check(current_state);
-            if (checkmate_state!=2) {
+            draw_state = repetition_draw(&game_keys, current_state.halfmove_clock, 3);
+            if (checkmate_state!=2 && draw_state==DRAW_NONE) {
                 if (checkmate_state) {
                     rectangle r = {0,20,0,20};
                     fill_rectangle(r, RED);
@@ -1439,45 +1525,74 @@ int main() {
 
 
                 // DRAW ONLY NEEDED REGION
-                if (current_state.en_passant_occured) {
-                    refresh_en_passant_tile(current_state);
+                if (full_redraw_pending) {
+                    // NEW GAME, FLIP OR RESYNC: EVERYTHING IN ONE STREAMING PASS
+                    redraw_board();
+                    full_redraw_pending = 0;
                     current_state.en_passant_occured = 0;
-                }
-                if (current_state.castling_occured) {
-                    refresh_castling_tile(current_state);
                     current_state.castling_occured = 0;
-                }
+                    current_state.select_active_last_draw = current_state.select.active;
+                } else if (current_state.cursor_moved && current_state.select.active==0 && current_state.select_active_last_draw==0 && select_under.count) {
+                    // ONLY THE SELECTOR MOVED: PUT BACK WHAT WAS UNDER ITS OLD FRAME
+                    save_under_restore(&select_under);
+                    draw_select_saving_under(current_state.select);
+                } else {
+                    if (current_state.en_passant_occured) {
+                        refresh_en_passant_tile(current_state);
+                        current_state.en_passant_occured = 0;
+                    }
+                    if (current_state.castling_occured) {
+                        refresh_castling_tile(current_state);
+                        current_state.castling_occured = 0;
+                    }
 
 
-                if (current_state.board_past_x!=current_state.select.x || current_state.board_past_y!=current_state.select.y) {
-                    refresh_tile(current_state.board_past_x, current_state.board_past_y, current_state);
-                }
-                refresh_tile(current_state.select.x, current_state.select.y, current_state);
-    
-                if (current_state.select.active) {
-                    // DRAW SELECTED PIECE ON TOP OF ALL OTHERS
-                    draw_piece(current_state.pieces[current_state.selected_piece_index]);
-                    draw_possible_moves();
-                    current_state.select_active_last_draw = 1;
-                } else {
-                    if (current_state.select_active_last_draw==1) {
-                        current_state.select_active_last_draw = 0;
-                        draw_over_potential_moves(current_move_set, current_state);
+                    if (current_state.board_past_x!=current_state.select.x || current_state.board_past_y!=current_state.select.y) {
+                        refresh_tile(current_state.board_past_x, current_state.board_past_y, current_state);
+                    }
+                    refresh_tile(current_state.select.x, current_state.select.y, current_state);
+        
+                    if (current_state.select.active) {
                         // DRAW SELECTED PIECE ON TOP OF ALL OTHERS
                         draw_piece(current_state.pieces[current_state.selected_piece_index]);
+                        draw_possible_moves();
+                        current_state.select_active_last_draw = 1;
+                    } else {
+                        if (current_state.select_active_last_draw==1) {
+                            current_state.select_active_last_draw = 0;
+                            draw_over_potential_moves(current_move_set, current_state);
+                            // DRAW SELECTED PIECE ON TOP OF ALL OTHERS
+                            draw_piece(current_state.pieces[current_state.selected_piece_index]);
+                        }
                     }
+
+                    draw_select_saving_under(current_state.select);
+                }
+                current_state.cursor_moved = 0;
+
+                if (input_pending) {
+                    latency_record((uint16_t)profile_now() - input_time);
+                    input_pending = 0;
                 }
-    
-                draw_select(current_state.select);
 
                 current_state.has_drawn=1;
             } else {
-                rectangle r = {0,100,0,100};
-                fill_rectangle(r, MAGENTA);
-                do {} while (1);
+                // GAME OVER: MAGENTA FOR CHECKMATE, YELLOW FOR A DRAW BY REPETITION OR FIFTY MOVES.
+                // THE MENU STAYS OPEN TO A LONG PRESS
+                if (!game_over) end_game();
+                if (full_redraw_pending) {
+                    redraw_board();
+                    full_redraw_pending = 0;
+                    current_state.en_passant_occured = 0;
+                    current_state.castling_occured = 0;
+                    current_state.select_active_last_draw = current_state.select.active;
+                }
+                rectangle r = {0,RESULT_RIGHT,0,RESULT_BOTTOM};
+                fill_rectangle(r, checkmate_state==2 ? MAGENTA : YELLOW);
+                current_state.has_drawn = 1;
             }
         }
-    } while (1);
+    } while (hal_running());
 
     return 0;
 }
@@ -3,11 +3,43 @@
  *           View this license at http://creativecommons.org/about/licenses/
  */
 
+#ifndef CHESS_H
+#define CHESS_H
+
+#include <stdint.h>
+#include "lcd.h"
+
 #define TILESIZE 30
 
 #define LIGHT_BROWN 0xCB46
 #define DARK_BROWN  0x79E3
 
+#define ROTARY_FAST_TICKS   4 // DETENTS UNDER ~33MS APART MOVE 3 SQUARES
+#define ROTARY_MEDIUM_TICKS 10 // UNDER ~80MS APART MOVE 2
+
+#define MENU_ITEMS  10
+#define POSITIONS   6
+#define MENU_LEFT   46
+#define MENU_TOP    8
+#define MENU_LINE   12
+
+#define LATENCY_BAR_HEIGHT  120
+#define LATENCY_BAR_BOTTOM  220
+
+#define TIME_CONTROLS   4
+#define CLOCK_WHITE_X   5   // CENTRED IN THE PANELS EITHER SIDE OF THE BOARD
+#define CLOCK_BLACK_X   285
+#define CLOCK_Y         116
+#define CLOCK_IDLE_COL  0x7BEF // GREY
+#define RESULT_RIGHT    39 // GAME RESULT PANEL, LEFT OF THE BOARD AND ABOVE THE CLOCK
+#define RESULT_BOTTOM   100
+
+#define MENU_DIRTY_NONE     0
+#define MENU_DIRTY_LABELS   1 // HIGHLIGHT MOVED
+#define MENU_DIRTY_ALL      2 // CLEAR AND DRAW LIST OR PAGE
+
+#define SELECT_UNDER_PIXELS 416 // 30x30 SELECTOR FRAME OF THICKNESS 3 (4 PIXELS WIDE)
+
 
 typedef struct {
     uint8_t data[24][3]; 
@@ -27,17 +59,28 @@ typedef struct {
     uint8_t active;
 } selector;
 
+// RULES ONLY, TWO BYTES. WHERE AND HOW A PIECE IS DRAWN COMES FROM x, y AND type
 typedef struct {
-    rectangle r;
-    uint8_t x;
-    uint8_t y;
-    uint8_t taken;
-    uint8_t team;
-    uint8_t type;
-    uint8_t first;
-    sprite *s;
+    uint8_t x:3;
+    uint8_t y:3;
+    uint8_t taken:1;
+    uint8_t first:1;
+    uint8_t type:4;
+    uint8_t team:1;
 } piece;
 
+typedef struct {
+    char *label;
+    void (*action)();   // RUN WHEN CHOSEN, OR
+    void (*page)();     // DRAWN IN PLACE OF THE LIST UNTIL ANOTHER BUTTON IS PRESSED
+} menu_item;
+
+typedef struct {
+    uint16_t seconds;   // 0 FOR UNTIMED
+    uint8_t increment;
+    uint8_t mode;
+} time_control;
+
 typedef struct {
     uint8_t possible_moves_x[32];
     uint8_t possible_moves_y[32];
@@ -57,161 +100,19 @@ typedef struct {
     uint8_t board_past_x;
     uint8_t board_past_y;
     uint8_t select_active_last_draw;
+    uint8_t cursor_moved;
     uint8_t en_passant_occured;
     uint8_t castling_occured;
 
     uint8_t can_en_passant;
     uint8_t en_passant_x;
     uint8_t en_passant_y;
+
+    uint8_t halfmove_clock;     // PLIES SINCE THE LAST PAWN MOVE OR CAPTURE
+    uint16_t fullmove_number;   // STARTS AT 1, UP AFTER EACH BLACK MOVE
 } game_state;
 
+// Piece images, defined in sprites.h
+extern sprite king, queen, bishop, rook, knight, pawn;
 
-sprite king = {{{0x00, 0x18, 0x00},
-                {0x00, 0x18, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x18, 0x00},
-                {0x00, 0x18, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0xFF, 0x00},
-                {0x01, 0xFF, 0x80},
-                {0x00, 0xFF, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x18, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0xFF, 0x00},
-                {0x00, 0xFF, 0x00},
-                {0x01, 0xFF, 0x80},
-                {0x01, 0xFF, 0x80},
-                {0x03, 0xFF, 0xC0},
-                {0x03, 0xFF, 0xC0}}};
-
-sprite queen = {{{0x01, 0x5A, 0x80},
-                 {0x01, 0x5A, 0x80},
-                 {0x01, 0xFF, 0x80},
-                 {0x00, 0xFF, 0x00},
-                 {0x00, 0x3C, 0x00},
-                 {0x00, 0x7E, 0x00},
-                 {0x00, 0xFF, 0x00},
-                 {0x00, 0xFF, 0x00},
-                 {0x00, 0xFF, 0x00},
-                 {0x00, 0x7E, 0x00},
-                 {0x00, 0x3C, 0x00},
-                 {0x00, 0xFF, 0x00},
-                 {0x01, 0xFF, 0x80},
-                 {0x01, 0xFF, 0x80},
-                 {0x00, 0x3C, 0x00},
-                 {0x00, 0x3C, 0x00},
-                 {0x00, 0x7E, 0x00},
-                 {0x00, 0x7E, 0x00},
-                 {0x00, 0xFF, 0x00},
-                 {0x00, 0xFF, 0x00},
-                 {0x01, 0xFF, 0x80},
-                 {0x01, 0xFF, 0x80},
-                 {0x03, 0xFF, 0xC0},
-                 {0x03, 0xFF, 0xC0},}};
-
-sprite bishop = {{{0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x18, 0x00},
-                  {0x00, 0x3C, 0x00},
-                  {0x00, 0x38, 0x00},
-                  {0x00, 0x72, 0x00},
-                  {0x00, 0x76, 0x00},
-                  {0x00, 0x7E, 0x00},
-                  {0x00, 0x3C, 0x00},
-                  {0x00, 0x3C, 0x00},
-                  {0x00, 0x18, 0x00},
-                  {0x00, 0x7E, 0x00},
-                  {0x00, 0xFF, 0x00},
-                  {0x00, 0x18, 0x00},
-                  {0x00, 0x3C, 0x00},
-                  {0x00, 0x3C, 0x00},
-                  {0x00, 0x7E, 0x00},
-                  {0x00, 0x7E, 0x00},
-                  {0x00, 0xFF, 0x00},
-                  {0x00, 0xFF, 0x00},
-                  {0x01, 0xFF, 0x80},
-                  {0x01, 0xFF, 0x80}}};
-
-sprite rook = {{{0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x99, 0x00},
-                {0x00, 0x99, 0x00},
-                {0x00, 0x99, 0x00},
-                {0x00, 0xFF, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x18, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0xFF, 0x00},
-                {0x00, 0xFF, 0x00}}};
-
-sprite knight = {{{0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x00, 0x00},
-                  {0x00, 0x38, 0x00},
-                  {0x00, 0x5C, 0x00},
-                  {0x01, 0xFC, 0x00},
-                  {0x03, 0xF8, 0x00},
-                  {0x03, 0xFC, 0x00},
-                  {0x01, 0x9E, 0x00},
-                  {0x00, 0x1E, 0x00},
-                  {0x00, 0x3E, 0x00},
-                  {0x00, 0x3E, 0x00},
-                  {0x00, 0x7E, 0x00},
-                  {0x00, 0x7F, 0x00},
-                  {0x00, 0x7F, 0x00},
-                  {0x00, 0xFF, 0x00},
-                  {0x00, 0xFF, 0x00},
-                  {0x00, 0xFF, 0x00},
-                  {0x01, 0xFF, 0x80},
-                  {0x01, 0xFF, 0x80}}};
-
-sprite pawn = {{{0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x00, 0x00},
-                {0x00, 0x18, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x18, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x18, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x3C, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0x7E, 0x00},
-                {0x00, 0xFF, 0x00},
-                {0x00, 0xFF, 0x00}}};
+#endif
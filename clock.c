@@ -0,0 +1,112 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include "clock.h"
+
+#define MOVES_TO_GO_MIN     20  /* time manager assumes at least this many left */
+#define BUDGET_RESERVE      (CLOCK_TICKS_PER_SECOND / 2)
+
+void clock_init(chess_clock *c, uint16_t seconds, uint8_t increment_seconds, uint8_t mode)
+{
+    c->remaining[0] = c->remaining[1] = seconds * CLOCK_TICKS_PER_SECOND;
+    c->increment = increment_seconds * CLOCK_TICKS_PER_SECOND;
+    c->mode = mode;
+    c->side = 0;
+    c->running = 0;
+    c->flagged = 0;
+    c->moves = 0;
+}
+
+/* Time left for a side, flagging the side to move when it reaches zero */
+uint32_t clock_remaining(chess_clock *c, uint8_t side, uint32_t now)
+{
+    uint32_t used;
+
+    if (!c->running || side != c->side)
+        return c->remaining[side];
+
+    used = now - c->turn_start;
+    if (used >= c->remaining[side]) {
+        c->remaining[side] = 0;
+        c->running = 0;
+        c->flagged = side + 1;
+        return 0;
+    }
+    return c->remaining[side] - used;
+}
+
+/* The side to move has finished its move; the first press starts the clock */
+void clock_press(chess_clock *c, uint32_t now)
+{
+    if (c->flagged)
+        return;
+
+    if (c->running) {
+        uint32_t used = now - c->turn_start;
+        uint32_t left = clock_remaining(c, c->side, now);
+        if (c->flagged)
+            return;
+        if (c->mode == CLOCK_BRONSTEIN)
+            left += used < c->increment ? used : c->increment;
+        else
+            left += c->increment;
+        c->remaining[c->side] = left;
+    }
+
+    c->moves++;
+    c->side = !c->side;
+    c->turn_start = now;
+    c->running = 1;
+}
+
+/* Hand the move over without an increment, for undo and redo */
+void clock_switch(chess_clock *c, uint32_t now)
+{
+    if (!c->running)
+        return;
+    c->remaining[c->side] = clock_remaining(c, c->side, now);
+    if (c->flagged)
+        return;
+    c->side = !c->side;
+    c->turn_start = now;
+}
+
+/* Game over: both clocks keep the time they show */
+void clock_stop(chess_clock *c, uint32_t now)
+{
+    if (!c->running)
+        return;
+    c->remaining[c->side] = clock_remaining(c, c->side, now);
+    c->running = 0;
+}
+
+/* Whose move it is while the clock is stopped: the press after that move
+ * starts the other side's clock */
+void clock_set_side(chess_clock *c, uint8_t side)
+{
+    if (!c->running)
+        c->side = side;
+}
+
+/* Ticks a player (or the engine) should spend on this move */
+uint32_t clock_budget(chess_clock *c, uint8_t side, uint32_t now)
+{
+    uint32_t left = clock_remaining(c, side, now);
+    uint16_t played = c->moves / 2;
+    uint16_t to_go = played < 40 - MOVES_TO_GO_MIN ? 40 - played : MOVES_TO_GO_MIN;
+    uint32_t budget;
+
+    if (left <= BUDGET_RESERVE)
+        return 0;
+    left -= BUDGET_RESERVE;
+
+    budget = left / to_go;
+    if (c->mode == CLOCK_BRONSTEIN)
+        budget += c->increment;         /* returned in full if not exceeded */
+    else
+        budget += c->increment * 3 / 4;
+
+    return budget < left ? budget : left;
+}
@@ -0,0 +1,38 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Chess clock in Timer 3 ticks (profile_now()). Nothing here runs from an
+ *  interrupt: time is charged from timestamps when the main loop asks.
+ */
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+
+#define CLOCK_FISCHER       0   /* increment added after every move */
+#define CLOCK_BRONSTEIN     1   /* time used is given back, up to the increment */
+
+#define CLOCK_TICKS_PER_SECOND  31250UL
+
+typedef struct {
+    uint32_t remaining[2];      /* ticks, as of turn_start for the side to move */
+    uint32_t increment;         /* ticks */
+    uint32_t turn_start;
+    uint8_t mode;
+    uint8_t side;               /* team whose clock runs */
+    uint8_t running;
+    uint8_t flagged;            /* team + 1 whose time ran out, 0 if none */
+    uint16_t moves;             /* completed moves, both sides */
+} chess_clock;
+
+void clock_init(chess_clock *c, uint16_t seconds, uint8_t increment_seconds, uint8_t mode);
+void clock_press(chess_clock *c, uint32_t now);
+void clock_switch(chess_clock *c, uint32_t now);
+void clock_stop(chess_clock *c, uint32_t now);
+void clock_set_side(chess_clock *c, uint8_t side);
+uint32_t clock_remaining(chess_clock *c, uint8_t side, uint32_t now);
+uint32_t clock_budget(chess_clock *c, uint8_t side, uint32_t now);
+
+#endif
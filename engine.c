@@ -0,0 +1,203 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include "engine.h"
+#include "rules.h"
+#include "profile.h"
+
+/* Indexed by (type-1)%6: pawn, rook, knight, bishop, queen, king */
+const int16_t engine_values[6] = {100, 500, 320, 330, 900, 0};
+
+void search_init(search_context *c, uint32_t limit, uint8_t max_depth)
+{
+    c->values = engine_values;
+    c->node_limit = 0;
+    c->depth_done = 0;
+    c->keys = 0;
+    c->limit = limit;
+    c->max_depth = max_depth > ENGINE_MAX_DEPTH ? ENGINE_MAX_DEPTH : max_depth;
+}
+
+/* Material balance from the side to move's point of view */
+int16_t evaluate(search_context *c, game_state g)
+{
+    int16_t score = 0;
+    uint8_t i;
+    for (i = 0; i < 32; i++) {
+        piece p = g.pieces[i];
+        if (p.taken)
+            continue;
+        if (p.team == g.turn)
+            score += c->values[(p.type - 1) % 6];
+        else
+            score -= c->values[(p.type - 1) % 6];
+    }
+    return score;
+}
+
+/* The first depth always finishes, so there is always a move to play */
+static uint8_t out_of_time(search_context *c)
+{
+    if (!c->stopped && c->depth && ((c->limit && profile_now() - c->start >= c->limit)
+                                    || (c->node_limit && c->nodes >= c->node_limit)))
+        c->stopped = 1;
+    return c->stopped;
+}
+
+static uint8_t is_promotion(piece p, uint8_t y)
+{
+    return (p.type == 1 && y == 0) || (p.type == 7 && y == 7);
+}
+
+/* The searched move: promotions are always to a queen */
+static game_state play(game_state g, uint8_t index, uint8_t x, uint8_t y)
+{
+    piece p = g.pieces[index];
+    g = make_move(g, index, x, y);
+    if (is_promotion(p, y))
+        g = promote_piece(g, index, PROMOTE_QUEEN);
+    return g;
+}
+
+/* Flagged like the game's own moves, so SAN shows castling and en passant */
+static packed_move pack(game_state *g, piece p, uint8_t x, uint8_t y)
+{
+    uint8_t from = p.y*8 + p.x, to = y*8 + x;
+    uint8_t flags = move_flags(*g, p.type, from, to);
+    return PACK_MOVE(from, to, flags, flags == MOVE_PROMOTION ? PROMOTE_QUEEN : 0);
+}
+
+static int16_t negamax(search_context *c, game_state g, uint8_t depth, uint8_t ply, int16_t alpha, int16_t beta);
+
+/* The score of the position after a move, for the side that made it. With
+ * the game's keys, a second time round or fifty moves is a draw and is not
+ * searched; the position is pushed while its moves are searched. */
+static int16_t child(search_context *c, game_state *g, uint8_t depth, uint8_t ply, int16_t alpha, int16_t beta)
+{
+    int16_t score;
+
+    if (!c->keys)
+        return -negamax(c, *g, depth, ply, -beta, -alpha);
+
+    repetition_push(c->keys, g);
+    if (repetition_draw(c->keys, g->halfmove_clock, 2))
+        score = 0;
+    else
+        score = -negamax(c, *g, depth, ply, -beta, -alpha);
+    repetition_pop(c->keys);
+    return score;
+}
+
+static int16_t negamax(search_context *c, game_state g, uint8_t depth, uint8_t ply, int16_t alpha, int16_t beta)
+{
+    uint8_t i, j, any = 0;
+
+    c->nodes++;
+    if (depth == 0)
+        return evaluate(c, g);
+
+    for (i = 0; i < 32; i++) {
+        piece p = g.pieces[i];
+        if (p.taken || p.team != g.turn)
+            continue;
+
+        move_set m = get_possible_moves_for_piece(p, g);
+        for (j = 0; j < m.num_possible_moves; j++) {
+            uint8_t x = m.possible_moves_x[j], y = m.possible_moves_y[j];
+            game_state next;
+            int16_t score;
+            if (x == p.x && y == p.y)
+                continue;
+            any = 1;
+
+            next = play(g, i, x, y);
+            score = child(c, &next, depth - 1, ply + 1, alpha, beta);
+            if (out_of_time(c))
+                return 0;
+            if (score >= beta)
+                return beta;
+            if (score > alpha)
+                alpha = score;
+        }
+    }
+
+    if (!any)
+        return check_in_check(g) ? -ENGINE_MATE + ply : 0;
+    return alpha;
+}
+
+/* One depth from the root, trying the best move so far first */
+static int16_t search_root(search_context *c, game_state g, uint8_t depth, packed_move *best)
+{
+    int16_t alpha = -ENGINE_MATE - 1;
+    uint8_t i, j, pass;
+
+    *best = ENGINE_NO_MOVE;
+    c->nodes++;
+
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < 32; i++) {
+            piece p = g.pieces[i];
+            if (p.taken || p.team != g.turn)
+                continue;
+
+            move_set m = get_possible_moves_for_piece(p, g);
+            for (j = 0; j < m.num_possible_moves; j++) {
+                uint8_t x = m.possible_moves_x[j], y = m.possible_moves_y[j];
+                packed_move move = pack(&g, p, x, y);
+                game_state next;
+                int16_t score;
+                if (x == p.x && y == p.y)
+                    continue;
+                if ((pass == 0) != (move == c->best))
+                    continue;
+
+                next = play(g, i, x, y);
+                score = child(c, &next, depth - 1, 1, alpha, ENGINE_MATE + 1);
+                if (out_of_time(c))
+                    return 0;
+                if (score > alpha) {
+                    alpha = score;
+                    *best = move;
+                }
+            }
+        }
+    }
+
+    if (*best == ENGINE_NO_MOVE)
+        return check_in_check(g) ? -ENGINE_MATE : 0;
+    return alpha;
+}
+
+packed_move search(search_context *c, game_state g)
+{
+    uint8_t depth;
+
+    c->start = profile_now();
+    c->stopped = 0;
+    c->nodes = 0;
+    c->depth = 0;
+    c->score = 0;
+    c->best = ENGINE_NO_MOVE;
+
+    for (depth = 1; depth <= c->max_depth; depth++) {
+        packed_move best;
+        int16_t score = search_root(c, g, depth, &best);
+        if (c->stopped)
+            break;
+
+        c->best = best;
+        c->score = score;
+        c->depth = depth;
+        if (c->depth_done)
+            c->depth_done(c);
+
+        /* Nothing to play, or a forced mate already found */
+        if (best == ENGINE_NO_MOVE || score > ENGINE_MATE - ENGINE_MAX_DEPTH || score < -ENGINE_MATE + ENGINE_MAX_DEPTH)
+            break;
+    }
+
+    return c->best;
+}
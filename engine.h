@@ -0,0 +1,48 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Material-only alpha-beta search over the game's own rules, deepened one
+ *  ply at a time until the time or depth limit. Everything the search needs
+ *  is in the search_context the caller passes in; there are no globals.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "chess.h"
+#include "history.h"
+#include "repetition.h"
+
+/* Every ply holds a few game_state copies on the stack */
+#ifdef __AVR__
+#define ENGINE_MAX_DEPTH    3
+#else
+#define ENGINE_MAX_DEPTH    8
+#endif
+#define ENGINE_MATE         30000
+#define ENGINE_NO_MOVE      0xFFFF
+
+typedef struct search_context {
+    const int16_t *values;      /* piece values by (type-1)%6, engine_values unless changed */
+    uint32_t start;             /* profile_now() ticks */
+    uint32_t limit;             /* ticks allowed, 0 for no limit */
+    uint32_t node_limit;        /* nodes allowed, 0 for no limit; the same every run */
+    void (*depth_done)(struct search_context *c);   /* after each depth, 0 for none */
+    key_stack *keys;            /* the game up to the position searched, 0 for none */
+    uint8_t max_depth;
+    uint8_t stopped;            /* ran out of time part way through a depth */
+
+    uint32_t nodes;
+    uint8_t depth;              /* last depth completed */
+    int16_t score;              /* centipawns, for the side to move */
+    packed_move best;
+} search_context;
+
+extern const int16_t engine_values[6];
+
+void search_init(search_context *c, uint32_t limit, uint8_t max_depth);
+packed_move search(search_context *c, game_state g);
+int16_t evaluate(search_context *c, game_state g);
+
+#endif
@@ -0,0 +1,316 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Host tool: runs the search over EPD test suites (WAC, ECM, STS and the
+ *  like) and scores it on the bm (best move) and am (avoid move)
+ *  operations. Every position gets the same budget, a node count by
+ *  default so runs repeat exactly, and positions are shared out over all
+ *  cores. A position is solved when the move played is a bm and not an am;
+ *  time to solution is where the search settled on it for good.
+ *
+ *      gcc -O2 -pthread -I. -o epd epd.c engine.c rules.c fen.c pgn.c history.c repetition.c profile.c
+ *      ./epd [-n nodes] [-t ms] [-d depth] [-j threads] [-q] suite.epd...
+ *
+ *  -n nodes    per position (default 200000, 0 for none)
+ *  -t ms       per position instead, or as well (timing varies run to run)
+ *  -d depth    deepest search (default ENGINE_MAX_DEPTH)
+ *  -q          summary only
+ *
+ *  The last line holds only the figures that do not depend on the machine,
+ *  so two commits can be compared with diff when a node budget is used.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chess.h"
+#include "rules.h"
+#include "fen.h"
+#include "pgn.h"
+#include "engine.h"
+#include "profile.h"
+
+#define MAX_PROBLEMS    4096
+#define MAX_MOVES       4       /* bm or am moves kept per position */
+#define MAX_ID          32
+#define MAX_THREADS     256
+
+typedef struct {
+    char fen[FEN_MAX];
+    char id[MAX_ID];
+    char bm[MAX_MOVES][SAN_MAX];
+    char am[MAX_MOVES][SAN_MAX];
+    uint8_t bm_count, am_count;
+
+    char best[SAN_MAX];
+    uint8_t solved;
+    uint8_t depth;
+    uint32_t nodes, ticks;
+    uint8_t solved_depth;       /* 0 when never settled on a right move */
+    uint32_t solved_nodes, solved_ticks;
+} problem;
+
+/* The search context first, so depth_done can find the rest */
+typedef struct {
+    search_context c;
+    game_state g;
+    key_stack keys;             /* the position alone: EPD has no moves before it */
+    problem *p;
+} run;
+
+static problem *problems;
+static int problem_count;
+static uint32_t node_limit = 200000, time_limit;
+static uint8_t max_depth = ENGINE_MAX_DEPTH;
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int next_problem;
+
+/* SAN without check marks, annotations or '=', and 0-0 as O-O */
+static void normalise(const char *in, char *out)
+{
+    uint8_t n = 0;
+    for (; *in && n < SAN_MAX - 1; in++) {
+        if (*in == '+' || *in == '#' || *in == '!' || *in == '?' || *in == '=')
+            continue;
+        out[n++] = *in == '0' ? 'O' : *in;
+    }
+    out[n] = '\0';
+}
+
+/* The operand words after opcode, up to the ';' */
+static uint8_t read_moves(const char *op, char moves[MAX_MOVES][SAN_MAX])
+{
+    char word[16];
+    uint8_t n = 0;
+    int used;
+    while (*op && *op != ';' && n < MAX_MOVES && sscanf(op, " %15[^; ]%n", word, &used) == 1) {
+        normalise(word, moves[n++]);
+        op += used;
+        while (*op == ' ')
+            op++;
+    }
+    return n;
+}
+
+static uint8_t read_problem(char *line, problem *p)
+{
+    game_state g;
+    char *op;
+    uint8_t spaces = 0;
+    size_t i;
+
+    /* Board, side, castling and en passant; EPD has no move counters */
+    for (i = 0; line[i] && i < FEN_MAX - 1; i++) {
+        if (line[i] == ' ' && ++spaces == 4)
+            break;
+        p->fen[i] = line[i];
+    }
+    p->fen[i] = '\0';
+    memset(&g, 0, sizeof(g));
+    if (spaces != 4 || !fen_read(p->fen, &g))
+        return 0;
+    fen_write(&g, p->fen);
+
+    p->bm_count = p->am_count = 0;
+    snprintf(p->id, MAX_ID, "%d", problem_count + 1);
+    for (op = line + i; op && *op; op = strchr(op, ';') ? strchr(op, ';') + 1 : 0) {
+        while (*op == ' ')
+            op++;
+        if (strncmp(op, "bm ", 3) == 0)
+            p->bm_count = read_moves(op + 3, p->bm);
+        else if (strncmp(op, "am ", 3) == 0)
+            p->am_count = read_moves(op + 3, p->am);
+        else if (strncmp(op, "id ", 3) == 0)
+            sscanf(op + 3, " \"%31[^\"]\"", p->id);
+    }
+    return p->bm_count || p->am_count;
+}
+
+static void read_suite(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[512];
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f) && problem_count < MAX_PROBLEMS) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+        if (read_problem(line, &problems[problem_count]))
+            problem_count++;
+        else
+            fprintf(stderr, "%s: skipping %s\n", path, line);
+    }
+    fclose(f);
+}
+
+static uint8_t is_right(problem *p, game_state g, packed_move m)
+{
+    char san[SAN_MAX], move[SAN_MAX];
+    uint8_t i;
+
+    if (m == ENGINE_NO_MOVE)
+        return 0;
+    san_write(g, m, check_checkmate(play_move(g, m)), san);
+    normalise(san, move);
+    for (i = 0; i < p->am_count; i++)
+        if (strcmp(move, p->am[i]) == 0)
+            return 0;
+    if (!p->bm_count)
+        return 1;
+    for (i = 0; i < p->bm_count; i++)
+        if (strcmp(move, p->bm[i]) == 0)
+            return 1;
+    return 0;
+}
+
+/* Keeps where the current run of right answers began */
+static void depth_done(search_context *c)
+{
+    run *r = (run *)c;
+    problem *p = r->p;
+
+    if (!is_right(p, r->g, c->best)) {
+        p->solved_depth = 0;
+    } else if (!p->solved_depth) {
+        p->solved_depth = c->depth;
+        p->solved_nodes = c->nodes;
+        p->solved_ticks = profile_now() - c->start;
+    }
+}
+
+static void *worker(void *unused)
+{
+    run r;
+
+    for (;;) {
+        int n;
+        pthread_mutex_lock(&lock);
+        n = next_problem++;
+        pthread_mutex_unlock(&lock);
+        if (n >= problem_count)
+            break;
+
+        problem *p = &problems[n];
+        memset(&r.g, 0, sizeof(r.g));
+        fen_read(p->fen, &r.g);
+        r.p = p;
+        search_init(&r.c, time_limit * PROFILE_TICKS_PER_SECOND / 1000, max_depth);
+        r.c.node_limit = node_limit;
+        r.c.depth_done = depth_done;
+        repetition_clear(&r.keys, &r.g);
+        r.c.keys = &r.keys;
+        p->solved_depth = 0;
+
+        packed_move m = search(&r.c, r.g);
+
+        p->ticks = profile_now() - r.c.start;
+        p->nodes = r.c.nodes;
+        p->depth = r.c.depth;
+        p->solved = is_right(p, r.g, m);
+        if (!p->solved)
+            p->solved_depth = 0;
+        if (m == ENGINE_NO_MOVE)
+            strcpy(p->best, "-");
+        else
+            san_write(r.g, m, check_checkmate(play_move(r.g, m)), p->best);
+    }
+
+    return unused;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: epd [-n nodes] [-t ms] [-d depth] [-j threads] [-q] suite.epd...\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[MAX_THREADS];
+    int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int quiet = 0, solved = 0, i, opt;
+    uint64_t nodes = 0, solved_nodes = 0, ticks = 0, solved_ticks = 0;
+    uint32_t start, wall;
+
+    while ((opt = getopt(argc, argv, "n:t:d:j:q")) != -1) {
+        switch (opt) {
+        case 'n':
+            node_limit = atol(optarg);
+            break;
+        case 't':
+            time_limit = atol(optarg);
+            break;
+        case 'd':
+            max_depth = atoi(optarg);
+            break;
+        case 'j':
+            thread_count = atoi(optarg);
+            break;
+        case 'q':
+            quiet = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind == argc)
+        usage();
+
+    problems = malloc(MAX_PROBLEMS * sizeof(problem));
+    for (i = optind; i < argc; i++)
+        read_suite(argv[i]);
+    if (problem_count == 0)
+        return 1;
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MAX_THREADS)
+        thread_count = MAX_THREADS;
+    if (thread_count > problem_count)
+        thread_count = problem_count;
+
+    start = profile_now();
+    for (i = 0; i < thread_count; i++)
+        pthread_create(&threads[i], NULL, worker, NULL);
+    for (i = 0; i < thread_count; i++)
+        pthread_join(threads[i], NULL);
+    wall = profile_now() - start;
+
+    for (i = 0; i < problem_count; i++) {
+        problem *p = &problems[i];
+        nodes += p->nodes;
+        ticks += p->ticks;
+        if (p->solved) {
+            solved++;
+            solved_nodes += p->solved_nodes;
+            solved_ticks += p->solved_ticks;
+        }
+        if (quiet)
+            continue;
+        printf("%-16s %-6s %-8s depth %u nodes %lu ms %lu", p->id, p->solved ? "solved" : "missed",
+               p->best, p->depth, (unsigned long)p->nodes,
+               (unsigned long)(p->ticks * PROFILE_US_PER_TICK / 1000));
+        if (p->solved)
+            printf(", found at depth %u nodes %lu ms %lu", p->solved_depth, (unsigned long)p->solved_nodes,
+                   (unsigned long)(p->solved_ticks * PROFILE_US_PER_TICK / 1000));
+        printf("\n");
+    }
+
+    printf("%d positions on %d threads, %.1f s, %.0f nodes/s per thread\n", problem_count, thread_count,
+           wall / (double)PROFILE_TICKS_PER_SECOND,
+           ticks ? nodes * (double)PROFILE_TICKS_PER_SECOND / ticks : 0);
+    if (solved)
+        printf("time to solution: mean %.0f ms\n", solved_ticks * PROFILE_US_PER_TICK / 1000.0 / solved);
+    printf("solved %d/%d, nodes %llu, nodes to solution %llu\n", solved, problem_count,
+           (unsigned long long)nodes, (unsigned long long)solved_nodes);
+
+    return 0;
+}
@@ -0,0 +1,235 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include "fen.h"
+
+/* Indexed by (type-1)%6 */
+static const char letters[6] = {'P', 'R', 'N', 'B', 'Q', 'K'};
+
+#define WHITE_KINGSIDE      0x01
+#define WHITE_QUEENSIDE     0x02
+#define BLACK_KINGSIDE      0x04
+#define BLACK_QUEENSIDE     0x08
+
+static uint8_t piece_letter_index(char c)
+{
+    uint8_t i;
+    if (c >= 'a' && c <= 'z')
+        c -= 'a' - 'A';
+    for (i = 0; i < 6; i++)
+        if (letters[i] == c)
+            return i;
+    return 6;
+}
+
+/* Stops at 65535 rather than wrapping, so a huge number stays huge */
+static const char *read_number(const char *s, uint16_t *n)
+{
+    uint32_t v;
+    if (*s < '0' || *s > '9')
+        return 0;
+    *n = 0;
+    while (*s >= '0' && *s <= '9') {
+        v = *n * 10UL + (*s++ - '0');
+        *n = v > 0xFFFF ? 0xFFFF : v;
+    }
+    return s;
+}
+
+/* Piece at (x, y) with the given type, 32 if none */
+static uint8_t find_piece(game_state *g, uint8_t type, uint8_t x, uint8_t y)
+{
+    uint8_t i;
+    for (i = 0; i < 32; i++)
+        if (!g->pieces[i].taken && g->pieces[i].type == type && g->pieces[i].x == x && g->pieces[i].y == y)
+            return i;
+    return 32;
+}
+
+/* Returns 1 and fills g if the FEN is usable, 0 (g untouched) otherwise */
+uint8_t fen_read(const char *fen, game_state *out)
+{
+    game_state g = *out;
+    uint8_t n = 0, x = 0, y = 0, i, kings = 0, rights = 0;
+    uint16_t number;
+
+    for (i = 0; i < 32; i++) {
+        g.pieces[i].taken = 1;
+        g.pieces[i].x = g.pieces[i].y = 0;
+        g.pieces[i].team = g.pieces[i].type = g.pieces[i].first = 0;
+    }
+
+    /* Placement, rank 8 (y=0) first */
+    for (; *fen && *fen != ' '; fen++) {
+        if (*fen == '/') {
+            if (x != 8 || ++y > 7)
+                return 0;
+            x = 0;
+        } else if (*fen >= '1' && *fen <= '8') {
+            x += *fen - '0';
+            if (x > 8)
+                return 0;
+        } else {
+            uint8_t kind = piece_letter_index(*fen);
+            uint8_t team = *fen >= 'a';
+            if (kind == 6 || x > 7 || n == 32)
+                return 0;
+            g.pieces[n].x = x++;
+            g.pieces[n].y = y;
+            g.pieces[n].taken = 0;
+            g.pieces[n].team = team;
+            g.pieces[n].type = kind + 1 + team*6;
+            if (kind == 5)
+                kings += team ? 0x10 : 0x01;
+            n++;
+        }
+    }
+    if (y != 7 || x != 8 || kings != 0x11)
+        return 0;
+
+    /* Side to move */
+    if (*fen++ != ' ')
+        return 0;
+    if (*fen != 'w' && *fen != 'b')
+        return 0;
+    g.turn = *fen++ == 'b';
+
+    /* Castling */
+    if (*fen++ != ' ')
+        return 0;
+    for (; *fen && *fen != ' '; fen++) {
+        if (*fen == 'K') rights |= WHITE_KINGSIDE;
+        else if (*fen == 'Q') rights |= WHITE_QUEENSIDE;
+        else if (*fen == 'k') rights |= BLACK_KINGSIDE;
+        else if (*fen == 'q') rights |= BLACK_QUEENSIDE;
+        else if (*fen != '-') return 0;
+    }
+
+    /* En passant target, stored as the square of the pawn that can be taken */
+    if (*fen++ != ' ')
+        return 0;
+    g.can_en_passant = 0;
+    if (*fen == '-') {
+        fen++;
+    } else {
+        if (fen[0] < 'a' || fen[0] > 'h' || (fen[1] != '3' && fen[1] != '6'))
+            return 0;
+        g.en_passant_x = fen[0] - 'a';
+        g.en_passant_y = fen[1] == '6' ? 3 : 4;
+        g.can_en_passant = find_piece(&g, fen[1] == '6' ? 7 : 1, g.en_passant_x, g.en_passant_y) != 32;
+        fen += 2;
+    }
+
+    /* Move counters are optional, but a halfmove clock too big to hold is refused */
+    g.halfmove_clock = 0;
+    g.fullmove_number = 1;
+    if (*fen == ' ' && (fen = read_number(fen + 1, &number))) {
+        if (number > 255)
+            return 0;
+        g.halfmove_clock = number;
+        if (*fen == ' ' && read_number(fen + 1, &number) && number)
+            g.fullmove_number = number;
+    }
+
+    /* first: pawns on their start rank, and kings and rooks that keep a castling right */
+    for (i = 0; i < n; i++) {
+        piece *p = &g.pieces[i];
+        if (p->type == 1) p->first = p->y == 6;
+        if (p->type == 7) p->first = p->y == 1;
+    }
+    if (rights & (WHITE_KINGSIDE | WHITE_QUEENSIDE)) {
+        i = find_piece(&g, 6, 4, 7);
+        if (i != 32) g.pieces[i].first = 1;
+    }
+    if (rights & (BLACK_KINGSIDE | BLACK_QUEENSIDE)) {
+        i = find_piece(&g, 12, 4, 0);
+        if (i != 32) g.pieces[i].first = 1;
+    }
+    if ((rights & WHITE_KINGSIDE) && (i = find_piece(&g, 2, 7, 7)) != 32) g.pieces[i].first = 1;
+    if ((rights & WHITE_QUEENSIDE) && (i = find_piece(&g, 2, 0, 7)) != 32) g.pieces[i].first = 1;
+    if ((rights & BLACK_KINGSIDE) && (i = find_piece(&g, 8, 7, 0)) != 32) g.pieces[i].first = 1;
+    if ((rights & BLACK_QUEENSIDE) && (i = find_piece(&g, 8, 0, 0)) != 32) g.pieces[i].first = 1;
+
+    g.selected_piece_index = 0;
+    g.past_x = g.past_y = 0;
+    *out = g;
+    return 1;
+}
+
+static char *write_number(char *s, uint16_t n)
+{
+    char digits[5];
+    uint8_t i = 0;
+    do {
+        digits[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    while (i)
+        *s++ = digits[--i];
+    return s;
+}
+
+/* A castling right is a king and rook that have both never moved */
+static uint8_t can_castle(game_state *g, uint8_t king, uint8_t rook, uint8_t rook_x, uint8_t y)
+{
+    uint8_t k = find_piece(g, king, 4, y);
+    uint8_t r = find_piece(g, rook, rook_x, y);
+    return k != 32 && r != 32 && g->pieces[k].first && g->pieces[r].first;
+}
+
+void fen_write(game_state *g, char *fen)
+{
+    char squares[64];
+    uint8_t i, x, y, empty;
+    char *castling;
+
+    for (i = 0; i < 64; i++)
+        squares[i] = 0;
+    for (i = 0; i < 32; i++) {
+        piece *p = &g->pieces[i];
+        if (!p->taken)
+            squares[p->y*8 + p->x] = letters[(p->type - 1) % 6] + (p->team ? 'a' - 'A' : 0);
+    }
+
+    for (y = 0; y < 8; y++) {
+        empty = 0;
+        for (x = 0; x < 8; x++) {
+            if (squares[y*8 + x]) {
+                if (empty) *fen++ = '0' + empty;
+                empty = 0;
+                *fen++ = squares[y*8 + x];
+            } else {
+                empty++;
+            }
+        }
+        if (empty) *fen++ = '0' + empty;
+        if (y < 7) *fen++ = '/';
+    }
+
+    *fen++ = ' ';
+    *fen++ = g->turn ? 'b' : 'w';
+
+    *fen++ = ' ';
+    castling = fen;
+    if (can_castle(g, 6, 2, 7, 7)) *fen++ = 'K';
+    if (can_castle(g, 6, 2, 0, 7)) *fen++ = 'Q';
+    if (can_castle(g, 12, 8, 7, 0)) *fen++ = 'k';
+    if (can_castle(g, 12, 8, 0, 0)) *fen++ = 'q';
+    if (fen == castling) *fen++ = '-';
+
+    *fen++ = ' ';
+    if (g->can_en_passant) {
+        *fen++ = 'a' + g->en_passant_x;
+        *fen++ = g->en_passant_y == 3 ? '6' : '3';
+    } else {
+        *fen++ = '-';
+    }
+
+    *fen++ = ' ';
+    fen = write_number(fen, g->halfmove_clock);
+    *fen++ = ' ';
+    fen = write_number(fen, g->fullmove_number);
+    *fen = 0;
+}
@@ -0,0 +1,21 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Forsyth-Edwards Notation for game_state. Only the rules fields are
+ *  touched; the selector and drawing flags are left to the caller.
+ */
+
+#ifndef FEN_H
+#define FEN_H
+
+#include "chess.h"
+
+#define FEN_MAX     92      /* longest FEN plus terminator */
+
+#define START_FEN   "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+
+uint8_t fen_read(const char *fen, game_state *g);
+void fen_write(game_state *g, char *fen);
+
+#endif
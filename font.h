@@ -3,7 +3,7 @@
  *           View this license at http://creativecommons.org/about/licenses/
  */
 
-#include <avr/pgmspace.h>
+#include "hal.h"
 
 const char font5x7[] PROGMEM = {
 	0x00, 0x00, 0x00, 0x00, 0x00, // SPACE
@@ -0,0 +1,78 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  The board underneath the game: clock and timers, interrupts and sleep,
+ *  the switch and wheel pins, the LCD's reset and backlight, and the EEPROM.
+ *  hal_avr.c drives the LaFortuna. hal_host.c stands in on Linux with the
+ *  emulated panel (ili934x_emu.c), wall clock timers, inputs read from a
+ *  script and a file for the EEPROM, so the same chess.c runs headless.
+ *
+ *  On the host, interrupt handlers are ordinary functions that only run
+ *  from inside hal_idle() (and the EEPROM ready handler from inside
+ *  hal_eeprom_ready_interrupt()), so cli() and sei() have nothing to mask.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdint.h>
+
+#ifdef __AVR__
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#else
+#include <string.h>
+
+#define ISR(vector, ...)    void vector(void)
+#define ISR_ALIASOF(vector)
+#define cli()
+#define sei()
+
+#define PROGMEM
+#define PGM_P               const char *
+#define pgm_read_byte(p)    (*(const uint8_t *)(p))
+#define pgm_read_ptr(p)     (*(void * const *)(p))
+#define strncpy_P           strncpy
+
+#define _delay_ms(ms)       /* the emulated panel is ready at once */
+
+#ifndef _BV
+#define _BV(bit)            (1 << (bit))
+#endif
+
+/* The port lines the inputs are wired to, as on the AT90USB1286 */
+#define PB6     6
+#define PC2     2
+#define PC3     3
+#define PC4     4
+#define PC5     5
+#define PE4     4
+#define PE5     5
+#define PE7     7
+#endif
+
+void hal_init(void);
+void hal_idle(void);
+uint8_t hal_running(void);
+
+void hal_switches_init(void);
+void hal_rotary_init(void);
+/* Active low, each switch at its own port bit: SWN..SWW as on port C,
+ * SWC (PE7) and OS_CD (PB6) overlaid on the unused bits */
+uint8_t hal_switch_pins(void);
+/* Wheel contacts A and B in bits 0 and 1 */
+uint8_t hal_rotary_pins(void);
+
+void hal_display_init(void);
+void hal_display_on(void);
+void hal_backlight(uint8_t brightness);
+
+uint8_t hal_eeprom_read(uint16_t address);
+void hal_eeprom_write(uint16_t address, uint8_t data);
+void hal_eeprom_ready_interrupt(uint8_t on);
+void hal_eeprom_wait(void);
+
+#endif
@@ -0,0 +1,155 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include <avr/sleep.h>
+#include <avr/power.h>
+#include <avr/eeprom.h>
+
+#include "hal.h"
+#include "ili934x.h"
+#include "ruota.h"
+#include "rotary.h"
+#include "profile.h"
+
+void hal_init(void)
+{
+    /* Clear DIV8 to get 8MHz clock */
+    CLKPR = (1 << CLKPCE);
+    CLKPR = 0;
+
+    /* Peripherals the game never uses */
+    power_adc_disable();
+    power_spi_disable();
+    power_twi_disable();
+    power_timer0_disable();
+
+    /* Enable tearing interrupt to get flicker free display */
+    EIMSK |= _BV(INT6);
+
+    /* Enable rotary interrupt to respond to input */
+    EIMSK |= _BV(INT4) | _BV(INT5);
+
+    /* Enable timer (Timer 1 CTC Mode 4) */
+    TCCR1A = 0;
+    TCCR1B = _BV(WGM12);
+    TCCR1B |= _BV(CS10);
+    TIMSK1 |= _BV(OCIE1A);
+    OCR1A = 65535;
+
+    /* Enable performance counter (Timer 3 CTC Mode 4) */
+    TCCR3A = 0;
+    TCCR3B = _BV(WGM32);
+    TCCR3B |= _BV(CS32);
+    TIMSK3 |= _BV(OCIE3A);
+    OCR3A = PROFILE_TICKS_PER_SECOND - 1; /* compare match every second */
+}
+
+/* Called with interrupts off; any interrupt wakes it */
+void hal_idle(void)
+{
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    sei(); /* takes effect after the next instruction, so sleep is entered first */
+    sleep_cpu();
+    sleep_disable();
+}
+
+uint8_t hal_running(void)
+{
+    return 1;
+}
+
+
+
+void hal_switches_init(void)
+{
+    DDRE &= ~_BV(SWC);   /* Central button */
+    PORTE |= _BV(SWC);
+
+    DDRC &= ~COMPASS_SWITCHES;  /* configure compass buttons for input */
+    PORTC |= COMPASS_SWITCHES;  /* and turn on pull up resistors */
+
+    EICRB |= _BV(ISC40) | _BV(ISC50) | _BV(ISC71);
+}
+
+void hal_rotary_init(void)
+{
+    /* Ensure all pins are inputs with pull-ups enabled */
+    DDRE &= ~_BV(ROTA) & ~_BV(ROTB) & ~_BV(SWC);
+    PORTE |= _BV(ROTA) | _BV(ROTB) | _BV(SWC);
+    DDRC &= ~_BV(SWN) & ~_BV(SWE) & ~_BV(SWS) & ~_BV(SWW);
+    PORTC |= _BV(SWN) | _BV(SWE) | _BV(SWS) | _BV(SWW);
+    /* Configure interrupt for any edge on rotary and falling edge for button */
+    EICRB |= _BV(ISC40) | _BV(ISC50) | _BV(ISC71);
+}
+
+/* Overlay port E for central button of switch wheel and port B for SD card detection switch */
+uint8_t hal_switch_pins(void)
+{
+    return (PINC | _BV(SWC) | _BV(OS_CD))
+         & (PINE | ~_BV(SWC))
+         & (PINB | ~_BV(OS_CD));
+}
+
+uint8_t hal_rotary_pins(void)
+{
+    return (PINE >> ROTA) & 0x03;
+}
+
+
+
+void hal_display_init(void)
+{
+    /* Enable extended memory interface with 10 bit addressing */
+    XMCRB = _BV(XMM2) | _BV(XMM1);
+    XMCRA = _BV(SRE);
+    DDRC |= _BV(RESET);
+    DDRB |= _BV(BLC);
+    _delay_ms(1);
+    PORTC &= ~_BV(RESET);
+    _delay_ms(20);
+    PORTC |= _BV(RESET);
+    _delay_ms(120);
+}
+
+/* Tearing effect on INT6, falling edge; backlight on */
+void hal_display_on(void)
+{
+    EICRB |= _BV(ISC61);
+    PORTB |= _BV(BLC);
+}
+
+void hal_backlight(uint8_t brightness)
+{
+    /* Configure Timer 2 Fast PWM Mode 3 */
+    TCCR2A = _BV(COM2A1) | _BV(WGM21) | _BV(WGM20);
+    TCCR2B = _BV(CS20);
+    OCR2A = brightness;
+}
+
+
+
+uint8_t hal_eeprom_read(uint16_t address)
+{
+    return eeprom_read_byte((const uint8_t *)address);
+}
+
+void hal_eeprom_write(uint16_t address, uint8_t data)
+{
+    eeprom_write_byte((uint8_t *)address, data);
+}
+
+void hal_eeprom_ready_interrupt(uint8_t on)
+{
+    if (on)
+        EECR |= _BV(EERIE);
+    else
+        EECR &= ~_BV(EERIE);
+}
+
+void hal_eeprom_wait(void)
+{
+    eeprom_busy_wait();
+}
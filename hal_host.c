@@ -0,0 +1,303 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  The board on Linux. Timer 1 and Timer 3 follow the wall clock, and their
+ *  handlers run from hal_idle(), which sleeps until the next switch scan.
+ *  The switches and the wheel are driven by a script named by $CHESS_SCRIPT,
+ *  one token per input, whitespace separated, '#' to the end of the line:
+ *
+ *      n e s w c       press and release that switch
+ *      c80             hold it for 80 scans (past REPEAT_START: a long press)
+ *      + -             one wheel detent clockwise or anticlockwise
+ *      . .40           let one or 40 scans go by
+ *
+ *  When the script has run out the game stops at its next idle, prints the
+ *  panel's bus statistics and checksum, and writes $CHESS_PNG if set.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hal.h"
+#include "ili934x_emu.h"
+#include "ruota.h"
+#include "rotary.h"
+#include "latency.h"
+#include "profile.h"
+
+#define SCAN_NS         8192000L    /* Timer 1: 65536 cycles at 8MHz */
+#define HOLD_SCANS      5           /* outlasts the four sample debounce */
+#define WHEEL_SCANS     12          /* keeps detents slower than ROTARY_MEDIUM_TICKS */
+#define SCRIPT_ENV      "CHESS_SCRIPT"
+#define PNG_ENV         "CHESS_PNG"
+#define EEPROM_FILE     "eeprom.bin"
+#define EEPROM_SIZE     4096
+
+/* Defined by chess.c and rotary.c; absent from tools that only link parts */
+extern void TIMER1_COMPA_vect(void) __attribute__((weak));
+extern void TIMER3_COMPA_vect(void) __attribute__((weak));
+extern void INT4_vect(void) __attribute__((weak));
+extern void EE_READY_vect(void) __attribute__((weak));
+
+/* Wheel contact states in clockwise order, each a quarter step on */
+static const uint8_t wheel_states[4] = {0x00, 0x02, 0x03, 0x01};
+
+static FILE *script;
+static uint8_t pins = 0xFF;         /* nothing pressed, no card */
+static uint8_t wheel;               /* index into wheel_states */
+static uint16_t hold, wait;         /* scans left with pins as they are, then released */
+static uint8_t finished;
+static uint32_t scans;
+
+static struct timespec next_scan;
+static time_t next_second;
+
+static FILE *eeprom;
+static uint8_t eeprom_memory[EEPROM_SIZE];  /* used instead if the file cannot be made */
+static uint8_t eeprom_in_memory;
+static uint8_t eeprom_ready;
+
+void hal_init(void)
+{
+    const char *path = getenv(SCRIPT_ENV);
+    if (path && !(script = fopen(path, "r")))
+        perror(path);
+
+    clock_gettime(CLOCK_MONOTONIC, &next_scan);
+    next_second = next_scan.tv_sec + 1;
+}
+
+static void turn_wheel(int8_t quarters)
+{
+    while (quarters) {
+        wheel = (wheel + (quarters > 0 ? 1 : 3)) & 3;
+        quarters += quarters > 0 ? -1 : 1;
+        if (INT4_vect)
+            INT4_vect();
+    }
+}
+
+static uint16_t read_count(uint16_t otherwise)
+{
+    int c = fgetc(script);
+    uint16_t n = 0;
+    if (c < '0' || c > '9') {
+        ungetc(c, script);
+        return otherwise;
+    }
+    while (c >= '0' && c <= '9') {
+        n = n * 10 + c - '0';
+        c = fgetc(script);
+    }
+    ungetc(c, script);
+    return n;
+}
+
+/* Sets up the pins for the next scan; 0 once the script has run out */
+static uint8_t script_step(void)
+{
+    static const char letters[5] = {'n', 'e', 's', 'w', 'c'};
+    static const uint8_t switches[5] = {_BV(SWN), _BV(SWE), _BV(SWS), _BV(SWW), _BV(SWC)};
+    int c;
+    uint8_t i;
+
+    if (hold) {
+        if (--hold == 0)
+            pins = 0xFF;
+        return 1;
+    }
+    if (wait) {
+        wait--;
+        return 1;
+    }
+    if (!script)
+        return 0;
+
+    while ((c = fgetc(script)) != EOF) {
+        if (c == '#') {
+            while ((c = fgetc(script)) != EOF && c != '\n')
+                ;
+            continue;
+        }
+        for (i = 0; i < 5; i++) {
+            if (c == letters[i]) {
+                pins = ~switches[i];
+                hold = read_count(HOLD_SCANS);
+                wait = HOLD_SCANS;
+                return 1;
+            }
+        }
+        if (c == '+' || c == '-') {
+            turn_wheel(c == '+' ? 2 : -2);
+            wait = WHEEL_SCANS;
+            return 1;
+        }
+        if (c == '.') {
+            wait = read_count(1);
+            if (wait)
+                wait--;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void report(void)
+{
+    emu_stats s = emu_total_stats();
+    const char *png = getenv(PNG_ENV);
+
+    printf("scans %lu, commands %lu, data bytes %lu, pixels %lu, bus cycles %lu, checksum %08lx\n",
+           (unsigned long)scans, (unsigned long)s.commands, (unsigned long)s.data_bytes,
+           (unsigned long)s.pixels, (unsigned long)s.bus_cycles, (unsigned long)emu_checksum());
+    latency_dump();
+#ifdef PROFILE
+    profile_dump();
+#endif
+    if (png && emu_dump_png(png))
+        perror(png);
+}
+
+/* Sleeps to the next switch scan and runs the handlers that are due */
+void hal_idle(void)
+{
+    struct timespec now;
+
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next_scan, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    if (!script_step())
+        finished = 1;
+    scans++;
+    if (TIMER1_COMPA_vect)
+        TIMER1_COMPA_vect();
+
+    /* Scans missed while the game was busy are not made up */
+    do {
+        next_scan.tv_nsec += SCAN_NS;
+        if (next_scan.tv_nsec >= 1000000000L) {
+            next_scan.tv_nsec -= 1000000000L;
+            next_scan.tv_sec++;
+        }
+    } while (next_scan.tv_sec < now.tv_sec || (next_scan.tv_sec == now.tv_sec && next_scan.tv_nsec <= now.tv_nsec));
+
+    if (now.tv_sec >= next_second) {
+        next_second = now.tv_sec + 1;
+        if (TIMER3_COMPA_vect)
+            TIMER3_COMPA_vect();
+    }
+}
+
+uint8_t hal_running(void)
+{
+    if (finished == 1) {
+        report();
+        finished = 2;
+    }
+    return !finished;
+}
+
+
+
+void hal_switches_init(void)
+{
+}
+
+void hal_rotary_init(void)
+{
+}
+
+uint8_t hal_switch_pins(void)
+{
+    return pins;
+}
+
+uint8_t hal_rotary_pins(void)
+{
+    return wheel_states[wheel];
+}
+
+
+
+void hal_display_init(void)
+{
+    emu_reset();
+}
+
+void hal_display_on(void)
+{
+}
+
+void hal_backlight(uint8_t brightness)
+{
+    (void)brightness;
+}
+
+
+
+/* A new EEPROM reads as all ones. 0 if there is no file and the game is
+ * saved in memory instead, lost when the program ends */
+static FILE *eeprom_file(void)
+{
+    uint16_t i;
+    if (eeprom || eeprom_in_memory)
+        return eeprom;
+    eeprom = fopen(EEPROM_FILE, "r+b");
+    if (!eeprom) {
+        eeprom = fopen(EEPROM_FILE, "w+b");
+        if (!eeprom) {
+            perror(EEPROM_FILE);
+            for (i = 0; i < EEPROM_SIZE; i++)
+                eeprom_memory[i] = 0xFF;
+            eeprom_in_memory = 1;
+            return 0;
+        }
+        for (i = 0; i < EEPROM_SIZE; i++)
+            fputc(0xFF, eeprom);
+        fflush(eeprom);
+    }
+    return eeprom;
+}
+
+uint8_t hal_eeprom_read(uint16_t address)
+{
+    FILE *f = eeprom_file();
+    int c;
+    if (!f)
+        return eeprom_memory[address];
+    fseek(f, address, SEEK_SET);
+    c = fgetc(f);
+    return c == EOF ? 0xFF : c;
+}
+
+void hal_eeprom_write(uint16_t address, uint8_t data)
+{
+    FILE *f = eeprom_file();
+    if (!f) {
+        eeprom_memory[address] = data;
+        return;
+    }
+    fseek(f, address, SEEK_SET);
+    fputc(data, f);
+}
+
+/* A file is always ready: the handler runs until it turns itself off */
+void hal_eeprom_ready_interrupt(uint8_t on)
+{
+    if (!on) {
+        eeprom_ready = 0;
+        fflush(eeprom_file());
+        return;
+    }
+    if (eeprom_ready)
+        return;
+    eeprom_ready = 1;
+    while (eeprom_ready && EE_READY_vect)
+        EE_READY_vect();
+}
+
+void hal_eeprom_wait(void)
+{
+}
@@ -0,0 +1,70 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include "history.h"
+
+#define SLOT(ply)   ((ply) & (HISTORY_SIZE - 1))
+
+void history_clear(move_history *h)
+{
+    h->oldest = h->current = h->newest = 0;
+}
+
+/* A new move: anything left to redo is gone */
+void history_push(move_history *h, packed_move m, undo_record u)
+{
+    h->moves[SLOT(h->current)] = m;
+    h->undo[SLOT(h->current)] = u;
+    h->current++;
+    h->newest = h->current;
+    if (h->current - h->oldest > HISTORY_SIZE)
+        h->oldest++;
+}
+
+uint8_t history_can_undo(move_history *h)
+{
+    return h->current != h->oldest;
+}
+
+uint8_t history_can_redo(move_history *h)
+{
+    return h->current != h->newest;
+}
+
+packed_move history_undo(move_history *h, undo_record *u)
+{
+    h->current--;
+    *u = h->undo[SLOT(h->current)];
+    return h->moves[SLOT(h->current)];
+}
+
+/* The move to replay; call history_redone with its undo record once made */
+packed_move history_redo(move_history *h)
+{
+    return h->moves[SLOT(h->current)];
+}
+
+void history_redone(move_history *h, undo_record u)
+{
+    h->undo[SLOT(h->current)] = u;
+    h->current++;
+}
+
+/* Amend the last move made, e.g. once the promotion piece is chosen */
+void history_set_last(move_history *h, packed_move m)
+{
+    h->moves[SLOT(h->current - 1)] = m;
+}
+
+/* Only valid for oldest <= ply < newest */
+packed_move history_ply(move_history *h, uint16_t ply)
+{
+    return h->moves[SLOT(ply)];
+}
+
+undo_record history_undo_record(move_history *h, uint16_t ply)
+{
+    return h->undo[SLOT(ply)];
+}
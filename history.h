@@ -0,0 +1,71 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Move history: 16-bit packed moves plus the few bytes unmake needs, in a
+ *  ring that forgets the oldest ply when full. Plies after the current
+ *  position are kept for redo until a new move is made.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+
+/* Plies, power of two: 384 bytes on the board, 768 on the host */
+#ifdef __AVR__
+#define HISTORY_SIZE    64
+#else
+#define HISTORY_SIZE    128
+#endif
+
+/* Squares are y*8+x, y=0 being black's back rank */
+typedef uint16_t packed_move;
+
+#define MOVE_NORMAL     0
+#define MOVE_CASTLE     1
+#define MOVE_EN_PASSANT 2
+#define MOVE_PROMOTION  3
+
+#define PROMOTE_KNIGHT  0
+#define PROMOTE_BISHOP  1
+#define PROMOTE_ROOK    2
+#define PROMOTE_QUEEN   3
+
+#define PACK_MOVE(from, to, flags, promotion) \
+    ((packed_move)((from) | ((to) << 6) | ((flags) << 12) | ((promotion) << 14)))
+#define MOVE_FROM(m)        ((m) & 0x3F)
+#define MOVE_TO(m)          (((m) >> 6) & 0x3F)
+#define MOVE_FLAGS(m)       (((m) >> 12) & 0x03)
+#define MOVE_PROMOTES_TO(m) (((m) >> 14) & 0x03)
+
+#define NO_CAPTURE      0xFF
+#define NO_EN_PASSANT   0xFF
+
+typedef struct {
+    uint8_t captured;           /* piece index, NO_CAPTURE if none */
+    uint8_t first;              /* mover's first-move flag before the move */
+    uint8_t en_passant;         /* square open to en passant before, or NO_EN_PASSANT */
+    uint8_t halfmove_clock;     /* before the move */
+} undo_record;
+
+typedef struct {
+    packed_move moves[HISTORY_SIZE];
+    undo_record undo[HISTORY_SIZE];
+    uint16_t oldest;            /* plies since the start of the game */
+    uint16_t current;
+    uint16_t newest;
+} move_history;
+
+void history_clear(move_history *h);
+void history_push(move_history *h, packed_move m, undo_record u);
+uint8_t history_can_undo(move_history *h);
+uint8_t history_can_redo(move_history *h);
+packed_move history_undo(move_history *h, undo_record *u);
+packed_move history_redo(move_history *h);
+void history_redone(move_history *h, undo_record u);
+void history_set_last(move_history *h, packed_move m);
+packed_move history_ply(move_history *h, uint16_t ply);
+undo_record history_undo_record(move_history *h, uint16_t ply);
+
+#endif
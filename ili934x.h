@@ -9,10 +9,21 @@
 #define CMD_ADDR  0x4000
 #define DATA_ADDR 0x4100
 
+#ifdef __AVR__
 #define write_cmd(cmd)				asm volatile("sts %0,%1" :: "i" (CMD_ADDR), "r" (cmd) : "memory");
 #define write_data(data)			asm volatile("sts %0,%1" :: "i" (DATA_ADDR), "r" (data) : "memory");
 #define write_data16(data)			asm volatile("sts %0,%B1 \n\t sts %0,%A1" :: "i" (DATA_ADDR), "r" (data)  : "memory");
 #define write_cmd_data(cmd, data)	asm volatile("sts %0,%1 \n\t sts %2,%3" :: "i" (CMD_ADDR), "r" (cmd), "i" (DATA_ADDR), "r" (data)  : "memory");
+#define read_data(data)				asm volatile("lds %0,%1" : "=r" (data) : "i" (DATA_ADDR) : "memory");
+#else
+/* Host build: the same bus traffic is fed to the emulated panel */
+#include "ili934x_emu.h"
+#define write_cmd(cmd)				emu_write_cmd(cmd);
+#define write_data(data)			emu_write_data(data);
+#define write_data16(data)			emu_write_data16(data);
+#define write_cmd_data(cmd, data)	emu_write_cmd_data(cmd, data);
+#define read_data(data)				data = emu_read_data();
+#endif
   
 /* Basic Commands */
 #define NO_OPERATION								0x00
@@ -0,0 +1,403 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Emulated ILI9341 for host builds. Models the column/page address window,
+ *  MEMORY_ACCESS_CONTROL orientation, MEMORY_WRITE/WRITE_MEMORY_CONTINUE
+ *  into a 240x320 RGB565 GRAM and MEMORY_READ/READ_MEMORY_CONTINUE back out
+ *  of it, and counts the bus traffic that produced it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ili934x.h"
+#include "ili934x_emu.h"
+
+#define MADCTL_MY   0x80
+#define MADCTL_MX   0x40
+#define MADCTL_MV   0x20
+
+static uint16_t gram[EMU_GRAM_HEIGHT][EMU_GRAM_WIDTH];
+
+static uint8_t  madctl;
+static uint8_t  cmd;
+static uint8_t  param_count;
+static uint8_t  params[4];
+static uint8_t  writing;
+static uint8_t  reading;            /* 0 idle, 1 dummy byte due, 2..4 R/G/B */
+static uint8_t  pixel_hi, have_hi;
+
+static uint16_t sc, ec, sp, ep;     /* active window */
+static uint16_t cc, cp;             /* write pointer */
+
+static emu_stats frame, total;
+
+static void count_write(uint8_t is_cmd)
+{
+    if (is_cmd) {
+        frame.commands++;
+        total.commands++;
+    } else {
+        frame.data_bytes++;
+        total.data_bytes++;
+    }
+    frame.bus_cycles += EMU_CYCLES_PER_WRITE;
+    total.bus_cycles += EMU_CYCLES_PER_WRITE;
+}
+
+static uint8_t map_to_gram(uint16_t c, uint16_t p, uint16_t *x, uint16_t *y)
+{
+    if (madctl & MADCTL_MV) {
+        *x = p;
+        *y = c;
+    } else {
+        *x = c;
+        *y = p;
+    }
+    if (*x >= EMU_GRAM_WIDTH || *y >= EMU_GRAM_HEIGHT)
+        return 0;
+    if (madctl & MADCTL_MX)
+        *x = EMU_GRAM_WIDTH-1 - *x;
+    if (madctl & MADCTL_MY)
+        *y = EMU_GRAM_HEIGHT-1 - *y;
+    return 1;
+}
+
+/* Address counter walks the window row by row and wraps at the end */
+static void advance_pointer(void)
+{
+    if (++cc > ec) {
+        cc = sc;
+        if (++cp > ep)
+            cp = sp;
+    }
+}
+
+static void store_pixel(uint16_t col)
+{
+    uint16_t x, y;
+    if (map_to_gram(cc, cp, &x, &y))
+        gram[y][x] = col;
+    frame.pixels++;
+    total.pixels++;
+    advance_pointer();
+}
+
+void emu_reset(void)
+{
+    memset(gram, 0, sizeof(gram));
+    madctl = 0;
+    cmd = NO_OPERATION;
+    param_count = 0;
+    writing = 0;
+    reading = 0;
+    have_hi = 0;
+    sc = 0; ec = EMU_GRAM_WIDTH-1;
+    sp = 0; ep = EMU_GRAM_HEIGHT-1;
+    cc = 0; cp = 0;
+    memset(&frame, 0, sizeof(frame));
+    memset(&total, 0, sizeof(total));
+}
+
+void emu_write_cmd(uint8_t c)
+{
+    count_write(1);
+    cmd = c;
+    param_count = 0;
+    have_hi = 0;
+    writing = 0;
+    reading = 0;
+
+    if (c==COLUMN_ADDRESS_SET || c==PAGE_ADDRESS_SET) {
+        frame.windows++;
+        total.windows++;
+    } else if (c==MEMORY_WRITE) {
+        cc = sc;
+        cp = sp;
+        writing = 1;
+    } else if (c==WRITE_MEMORY_CONTINUE) {
+        writing = 1;
+    } else if (c==MEMORY_READ) {
+        cc = sc;
+        cp = sp;
+        reading = 1;
+    } else if (c==READ_MEMORY_CONTINUE) {
+        reading = 1;
+    } else if (c==SOFTWARE_RESET) {
+        madctl = 0;
+    }
+}
+
+void emu_write_data(uint8_t d)
+{
+    count_write(0);
+
+    if (writing) {
+        if (have_hi) {
+            store_pixel(((uint16_t)pixel_hi << 8) | d);
+            have_hi = 0;
+        } else {
+            pixel_hi = d;
+            have_hi = 1;
+        }
+        return;
+    }
+
+    if (param_count < sizeof(params))
+        params[param_count] = d;
+    param_count++;
+
+    if (cmd==MEMORY_ACCESS_CONTROL && param_count==1) {
+        madctl = d;
+    } else if (cmd==COLUMN_ADDRESS_SET && param_count==4) {
+        sc = ((uint16_t)params[0] << 8) | params[1];
+        ec = ((uint16_t)params[2] << 8) | params[3];
+    } else if (cmd==PAGE_ADDRESS_SET && param_count==4) {
+        sp = ((uint16_t)params[0] << 8) | params[1];
+        ep = ((uint16_t)params[2] << 8) | params[3];
+    }
+}
+
+void emu_write_data16(uint16_t d)
+{
+    emu_write_data(d >> 8);
+    emu_write_data(d & 0xFF);
+}
+
+void emu_write_cmd_data(uint8_t c, uint8_t d)
+{
+    emu_write_cmd(c);
+    emu_write_data(d);
+}
+
+/* Pixels read back as 18-bit RGB666, one byte per channel (6 bits, left
+   aligned), after a dummy byte, as the panel does in 16 bit/pixel mode */
+uint8_t emu_read_data(void)
+{
+    uint16_t x, y, col = 0;
+    uint8_t d = 0;
+
+    frame.reads++;
+    total.reads++;
+    frame.bus_cycles += EMU_CYCLES_PER_READ;
+    total.bus_cycles += EMU_CYCLES_PER_READ;
+
+    if (reading==0)
+        return 0;
+    if (reading==1) {
+        reading = 2;
+        return 0;
+    }
+    if (map_to_gram(cc, cp, &x, &y))
+        col = gram[y][x];
+    if (reading==2) {
+        d = (col >> 8) & 0xF8;
+    } else if (reading==3) {
+        d = (col >> 3) & 0xFC;
+    } else {
+        d = (col << 3) & 0xF8;
+        advance_pointer();
+    }
+    reading = reading==4 ? 2 : reading+1;
+    return d;
+}
+
+void emu_frame_begin(void)
+{
+    memset(&frame, 0, sizeof(frame));
+}
+
+emu_stats emu_frame_end(void)
+{
+    emu_stats s = frame;
+    memset(&frame, 0, sizeof(frame));
+    return s;
+}
+
+emu_stats emu_total_stats(void)
+{
+    return total;
+}
+
+uint16_t emu_view_width(void)
+{
+    return (madctl & MADCTL_MV) ? EMU_GRAM_HEIGHT : EMU_GRAM_WIDTH;
+}
+
+uint16_t emu_view_height(void)
+{
+    return (madctl & MADCTL_MV) ? EMU_GRAM_WIDTH : EMU_GRAM_HEIGHT;
+}
+
+/* Pixel as seen through the current orientation, as the panel shows it */
+uint16_t emu_get_pixel(uint16_t x, uint16_t y)
+{
+    uint16_t gx, gy;
+    if (!map_to_gram(x, y, &gx, &gy))
+        return 0;
+    return gram[gy][gx];
+}
+
+uint32_t emu_checksum(void)
+{
+    uint32_t h = 2166136261u;   /* FNV-1a */
+    uint16_t x, y, w = emu_view_width(), ht = emu_view_height();
+    for (y=0; y<ht; y++)
+        for (x=0; x<w; x++) {
+            uint16_t c = emu_get_pixel(x, y);
+            h = (h ^ (c >> 8)) * 16777619u;
+            h = (h ^ (c & 0xFF)) * 16777619u;
+        }
+    return h;
+}
+
+static void rgb565_to_rgb888(uint16_t c, uint8_t *out)
+{
+    uint8_t r = (c >> 11) & 0x1F, g = (c >> 5) & 0x3F, b = c & 0x1F;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+int emu_dump_ppm(const char *path)
+{
+    uint16_t x, y, w = emu_view_width(), h = emu_view_height();
+    uint8_t rgb[3];
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return -1;
+    fprintf(f, "P6\n%u %u\n255\n", w, h);
+    for (y=0; y<h; y++)
+        for (x=0; x<w; x++) {
+            rgb565_to_rgb888(emu_get_pixel(x, y), rgb);
+            fwrite(rgb, 1, 3, f);
+        }
+    return fclose(f);
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *buf, size_t len)
+{
+    size_t i;
+    uint8_t k;
+    crc = ~crc;
+    for (i=0; i<len; i++) {
+        crc ^= buf[i];
+        for (k=0; k<8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+    }
+    return ~crc;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+
+static void png_chunk(FILE *f, const char *type, const uint8_t *data, uint32_t len)
+{
+    uint8_t be[4];
+    uint32_t crc;
+    put_be32(be, len);
+    fwrite(be, 1, 4, f);
+    fwrite(type, 1, 4, f);
+    if (len)
+        fwrite(data, 1, len, f);
+    crc = crc32_update(0, (const uint8_t *)type, 4);
+    crc = crc32_update(crc, data, len);
+    put_be32(be, crc);
+    fwrite(be, 1, 4, f);
+}
+
+/* Uncompressed (stored deflate blocks) PNG, so no zlib is needed */
+int emu_dump_png(const char *path)
+{
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    uint16_t x, y, w = emu_view_width(), h = emu_view_height();
+    size_t raw_len = (size_t)h * (1 + 3*w);
+    size_t blocks = (raw_len + 65534) / 65535;
+    size_t z_len = 2 + raw_len + 5*blocks + 4;
+    uint8_t *raw = malloc(raw_len);
+    uint8_t *z = malloc(z_len);
+    uint8_t ihdr[13];
+    uint32_t a = 1, b = 0;
+    size_t i, o, n;
+    FILE *f;
+
+    if (!raw || !z) {
+        free(raw);
+        free(z);
+        return -1;
+    }
+
+    for (y=0, o=0; y<h; y++) {
+        raw[o++] = 0;   /* filter: none */
+        for (x=0; x<w; x++, o+=3)
+            rgb565_to_rgb888(emu_get_pixel(x, y), &raw[o]);
+    }
+
+    z[0] = 0x78;
+    z[1] = 0x01;
+    for (i=0, o=2; i<raw_len; i+=n) {
+        n = raw_len - i > 65535 ? 65535 : raw_len - i;
+        z[o++] = (i + n == raw_len);
+        z[o++] = n & 0xFF;
+        z[o++] = n >> 8;
+        z[o++] = ~n & 0xFF;
+        z[o++] = (~n >> 8) & 0xFF;
+        memcpy(&z[o], &raw[i], n);
+        o += n;
+    }
+    for (i=0; i<raw_len; i++) {
+        a = (a + raw[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    put_be32(&z[o], (b << 16) | a);
+
+    put_be32(&ihdr[0], w);
+    put_be32(&ihdr[4], h);
+    ihdr[8] = 8;    /* bit depth */
+    ihdr[9] = 2;    /* truecolour */
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+    f = fopen(path, "wb");
+    if (f) {
+        fwrite(signature, 1, sizeof(signature), f);
+        png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+        png_chunk(f, "IDAT", z, z_len);
+        png_chunk(f, "IEND", NULL, 0);
+    }
+    free(raw);
+    free(z);
+    return f ? fclose(f) : -1;
+}
+
+/* Number of pixels that differ from a golden PPM, or -1 if it cannot be used */
+int32_t emu_compare_ppm(const char *path)
+{
+    unsigned fw, fh, maxval;
+    uint16_t x, y;
+    uint8_t rgb[3], ref[3];
+    int32_t diff = 0;
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return -1;
+    if (fscanf(f, "P6 %u %u %u", &fw, &fh, &maxval)!=3 || fgetc(f)==EOF ||
+        fw!=emu_view_width() || fh!=emu_view_height() || maxval!=255) {
+        fclose(f);
+        return -1;
+    }
+    for (y=0; y<fh; y++)
+        for (x=0; x<fw; x++) {
+            if (fread(ref, 1, 3, f)!=3) {
+                fclose(f);
+                return -1;
+            }
+            rgb565_to_rgb888(emu_get_pixel(x, y), rgb);
+            if (memcmp(rgb, ref, 3))
+                diff++;
+        }
+    fclose(f);
+    return diff;
+}
@@ -0,0 +1,53 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Host-side stand-in for the ILI9341 on the external memory bus of the
+ *  LaFortuna's AT90USB1286.
+ *  ili934x.h routes write_cmd/write_data/write_data16 here when __AVR__ is
+ *  not defined, so lcd.c and the rendering in chess.c run unchanged on Linux.
+ */
+
+#ifndef ILI934X_EMU_H
+#define ILI934X_EMU_H
+
+#include <stdint.h>
+
+#define EMU_GRAM_WIDTH      240
+#define EMU_GRAM_HEIGHT     320
+
+/* Every bus access is a single "sts"/"lds" (2 cycles) on the AT90USB1286 */
+#define EMU_CYCLES_PER_WRITE    2
+#define EMU_CYCLES_PER_READ     2
+
+typedef struct {
+    uint32_t commands;      /* command bytes written */
+    uint32_t data_bytes;    /* parameter and pixel bytes written */
+    uint32_t windows;       /* COLUMN/PAGE_ADDRESS_SET commands */
+    uint32_t pixels;        /* pixels stored into GRAM */
+    uint32_t reads;         /* bytes read back (dummy byte included) */
+    uint32_t bus_cycles;    /* estimated CPU cycles spent on the bus */
+} emu_stats;
+
+void emu_reset(void);
+
+void emu_write_cmd(uint8_t cmd);
+void emu_write_data(uint8_t data);
+void emu_write_data16(uint16_t data);
+void emu_write_cmd_data(uint8_t cmd, uint8_t data);
+uint8_t emu_read_data(void);
+
+void emu_frame_begin(void);
+emu_stats emu_frame_end(void);
+emu_stats emu_total_stats(void);
+
+uint16_t emu_get_pixel(uint16_t x, uint16_t y);
+uint16_t emu_view_width(void);
+uint16_t emu_view_height(void);
+uint32_t emu_checksum(void);
+
+int emu_dump_ppm(const char *path);
+int emu_dump_png(const char *path);
+int32_t emu_compare_ppm(const char *path);
+
+#endif
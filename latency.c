@@ -0,0 +1,67 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#ifndef __AVR__
+#include <stdio.h>
+#endif
+#include "latency.h"
+#include "profile.h"
+
+latency_histogram latency;
+
+void latency_record(uint16_t ticks)
+{
+    uint16_t bucket = ticks / LATENCY_BUCKET_TICKS;
+
+    if (latency.samples == 0xFFFF)
+        return;
+    if (bucket > LATENCY_BUCKETS)
+        bucket = LATENCY_BUCKETS;
+    latency.counts[bucket]++;
+    latency.samples++;
+    if (ticks > latency.max)
+        latency.max = ticks;
+}
+
+/* Upper edge of the bucket holding the given percentile, in ticks, but
+ * never more than the slowest press actually seen */
+uint16_t latency_percentile(uint8_t percent)
+{
+    uint32_t wanted = ((uint32_t)latency.samples * percent + 99) / 100;
+    uint32_t seen = 0;
+    uint16_t edge;
+    uint8_t i;
+
+    if (latency.samples == 0)
+        return 0;
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += latency.counts[i];
+        if (seen >= wanted) {
+            edge = (i + 1) * LATENCY_BUCKET_TICKS;
+            return edge < latency.max ? edge : latency.max;
+        }
+    }
+    return latency.max;
+}
+
+#ifndef __AVR__
+void latency_dump(void)
+{
+    uint8_t i;
+    printf("latency: %u samples, p50 <= %lu us, p99 <= %lu us, max %lu us\n",
+           latency.samples,
+           (unsigned long)latency_percentile(50) * PROFILE_US_PER_TICK,
+           (unsigned long)latency_percentile(99) * PROFILE_US_PER_TICK,
+           (unsigned long)latency.max * PROFILE_US_PER_TICK);
+    for (i = 0; i <= LATENCY_BUCKETS; i++) {
+        if (latency.counts[i] == 0)
+            continue;
+        if (i < LATENCY_BUCKETS)
+            printf("  < %3u ms %6u\n", (i + 1) * LATENCY_BUCKET_TICKS * PROFILE_US_PER_TICK / 1000, latency.counts[i]);
+        else
+            printf("  slower   %6u\n", latency.counts[i]);
+    }
+}
+#endif
@@ -0,0 +1,32 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Input-to-photon latency: from the debounced press seen by scan_switches
+ *  to the end of the draw_select that shows its result. Times are Timer 3
+ *  ticks (see profile.h).
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#define LATENCY_BUCKET_TICKS    125     /* 4ms per bucket */
+#define LATENCY_BUCKETS         32      /* 0-128ms, plus one for anything slower */
+
+typedef struct {
+    uint16_t counts[LATENCY_BUCKETS + 1];
+    uint16_t samples;
+    uint16_t max;                       /* ticks */
+} latency_histogram;
+
+extern latency_histogram latency;
+
+void latency_record(uint16_t ticks);
+uint16_t latency_percentile(uint8_t percent);
+#ifndef __AVR__
+void latency_dump(void);
+#endif
+
+#endif
@@ -6,9 +6,7 @@
  *  - Jan 2015  Modified for LaFortuna (Rev A, black edition) [KPZ]
  */
 
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "font.h"
 #include "ili934x.h"
 #include "lcd.h"
@@ -17,16 +15,7 @@ lcd display;
 
 void init_lcd()
 {
-    /* Enable extended memory interface with 10 bit addressing */
-    XMCRB = _BV(XMM2) | _BV(XMM1);
-    XMCRA = _BV(SRE);
-    DDRC |= _BV(RESET);
-    DDRB |= _BV(BLC);
-    _delay_ms(1);
-    PORTC &= ~_BV(RESET);
-    _delay_ms(20);
-    PORTC |= _BV(RESET);
-    _delay_ms(120);
+    hal_display_init();
     write_cmd(DISPLAY_OFF);
     write_cmd(SLEEP_OUT);
     _delay_ms(60);
@@ -49,16 +38,12 @@ void init_lcd()
     write_cmd(DISPLAY_ON);
     _delay_ms(50);
     write_cmd_data(TEARING_EFFECT_LINE_ON, 0x00);
-    EICRB |= _BV(ISC61);
-    PORTB |= _BV(BLC);
+    hal_display_on();
 }
 
 void lcd_brightness(uint8_t i)
 {
-    /* Configure Timer 2 Fast PWM Mode 3 */
-    TCCR2A = _BV(COM2A1) | _BV(WGM21) | _BV(WGM20);
-    TCCR2B = _BV(CS20);
-    OCR2A = i;
+    hal_backlight(i);
 }
 
 void set_orientation(orientation o)
@@ -182,6 +167,57 @@ void fill_rectangle_indexed(rectangle r, uint16_t* col)
             write_data16(*col++);
 }
 
+void read_rectangle(rectangle r, uint16_t* col)
+{
+    uint16_t n = (r.right - r.left + 1) * (r.bottom - r.top + 1);
+    uint8_t red, green, blue;
+    write_cmd(COLUMN_ADDRESS_SET);
+    write_data16(r.left);
+    write_data16(r.right);
+    write_cmd(PAGE_ADDRESS_SET);
+    write_data16(r.top);
+    write_data16(r.bottom);
+    write_cmd(MEMORY_READ);
+    read_data(red);     /* dummy read */
+    /* Memory is read back as RGB666, one left-aligned byte per channel */
+    while(n--) {
+        read_data(red);
+        read_data(green);
+        read_data(blue);
+        *col++ = ((uint16_t)(red & 0xF8) << 8) | ((uint16_t)(green & 0xFC) << 3) | (blue >> 3);
+    }
+}
+
+uint8_t save_under_capture(save_under* s, rectangle* r, uint8_t count)
+{
+    uint8_t i;
+    uint16_t used = 0, n;
+    s->count = 0;
+    if (count > SAVE_UNDER_RECTS)
+        return 0;
+    for(i=0; i<count; i++) {
+        n = (r[i].right - r[i].left + 1) * (r[i].bottom - r[i].top + 1);
+        if (used + n > s->capacity)
+            return 0;
+        read_rectangle(r[i], s->pixels + used);
+        s->r[i] = r[i];
+        used += n;
+    }
+    s->count = count;
+    return 1;
+}
+
+void save_under_restore(save_under* s)
+{
+    uint8_t i;
+    uint16_t* p = s->pixels;
+    for(i=0; i<s->count; i++) {
+        fill_rectangle_indexed(s->r[i], p);
+        p += (s->r[i].right - s->r[i].left + 1) * (s->r[i].bottom - s->r[i].top + 1);
+    }
+    s->count = 0;
+}
+
 void clear_screen()
 {
     display.x = 0;
@@ -190,6 +226,36 @@ void clear_screen()
     fill_rectangle(r, display.background);
 }
 
+void load_glyph(glyph* g, char c)
+{
+    uint8_t x, y, bits;
+    PGM_P fdata = (c - ' ')*5 + font5x7;
+
+    for(y=0; y<8; y++)
+        g->rows[y] = 0;
+    for(x=0; x<5; x++) {
+        bits = pgm_read_byte(fdata++);
+        for(y=0; y<8; y++)
+            if (bits & _BV(y)) g->rows[y] |= _BV(x);
+    }
+}
+
+void draw_glyph(glyph* g, uint16_t x, uint16_t y)
+{
+    uint8_t row, col;
+
+    write_cmd(COLUMN_ADDRESS_SET);
+    write_data16(x);
+    write_data16(x+5);
+    write_cmd(PAGE_ADDRESS_SET);
+    write_data16(y);
+    write_data16(y+7);
+    write_cmd(MEMORY_WRITE);
+    for(row=0; row<8; row++)
+        for(col=0; col<6; col++)
+            write_data16((g->rows[row] & _BV(col)) ? display.foreground : display.background);
+}
+
 void display_char(char c)
 {
     uint16_t x, y;
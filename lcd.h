@@ -3,7 +3,14 @@
  *           View this license at http://creativecommons.org/about/licenses/
  */
  
+#ifndef LCD_H
+#define LCD_H
+
+#ifdef __AVR__
 #include <avr/io.h>
+#elif !defined(_BV)
+#define _BV(bit) (1 << (bit))
+#endif
 #include <stdint.h>
 
 
@@ -36,6 +43,22 @@ typedef struct {
 	uint16_t top, bottom;
 } rectangle;	
 
+/* Pixels captured from the panel so they can be put back with one blit each */
+#define SAVE_UNDER_RECTS	4
+
+typedef struct {
+	rectangle r[SAVE_UNDER_RECTS];
+	uint8_t count;
+	uint16_t capacity;
+	uint16_t* pixels;
+} save_under;
+
+/* Character rows expanded from font5x7 once, so drawing one is a single
+   6x8 window instead of a window per column */
+typedef struct {
+	uint8_t rows[8];	/* bit 0 is the leftmost column */
+} glyph;
+
 void init_lcd();
 void lcd_brightness(uint8_t i);
 void set_orientation(orientation o);
@@ -43,7 +66,14 @@ void set_frame_rate_hz(uint8_t f);
 void clear_screen();
 void fill_rectangle(rectangle r, uint16_t col);
 void fill_rectangle_indexed(rectangle r, uint16_t* col);
+void read_rectangle(rectangle r, uint16_t* col);
+uint8_t save_under_capture(save_under* s, rectangle* r, uint8_t count);
+void save_under_restore(save_under* s);
+void load_glyph(glyph* g, char c);
+void draw_glyph(glyph* g, uint16_t x, uint16_t y);
 void display_char(char c);
 void display_string(char *str);
 void display_string_xy(char *str, uint16_t x, uint16_t y);
 void display_register(uint8_t reg);
+
+#endif
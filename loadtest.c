@@ -0,0 +1,220 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Host tool: many games at once through the session API. Each thread has
+ *  its own pool and keeps its share of the games open, playing one random
+ *  legal move in each per round, plus one random move that is usually
+ *  illegal. A game that ends, or reaches the ply limit, is taken back to
+ *  its start with session_undo(), checked against the FEN it opened with,
+ *  closed and replaced, so the pool is always in use.
+ *
+ *      gcc -O2 -pthread -I. -o loadtest loadtest.c session.c history.c rules.c fen.c
+ *      ./loadtest [-g games] [-j threads] [-r rounds] [-p plies]
+ *
+ *  A round plays up to two plies, so -p is kept below HISTORY_SIZE for
+ *  every game to undo back to its start.
+ *
+ *  Build without -DPROFILE: the section timers are shared between threads.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "session.h"
+#include "fen.h"
+
+#define MAX_THREADS     256
+#define MAX_POOL        65535
+
+typedef struct {
+    pthread_t thread;
+    uint32_t games;
+    uint32_t seed;
+
+    uint64_t validated;         /* session_move() calls */
+    uint64_t accepted;
+    uint64_t wrong;             /* illegal moves accepted, or an undo that did not get back */
+    uint32_t finished;
+} worker;
+
+static int rounds = 10, max_plies = 100;
+
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/* A random legal move, or 0 when the side to move has none */
+static uint8_t random_move(session *s, uint32_t *seed, packed_move *m)
+{
+    packed_move moves[SESSION_MAX_MOVES];
+    uint8_t start = next_random(seed) % 64, i, n;
+
+    for (i = 0; i < 64; i++) {
+        n = session_moves_from(s, (start + i) % 64, moves);
+        if (n) {
+            *m = moves[next_random(seed) % n];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Any from and to; legal only if session_moves_from() lists it */
+static uint8_t is_listed(session *s, packed_move m)
+{
+    packed_move moves[SESSION_MAX_MOVES];
+    uint8_t i, n = session_moves_from(s, MOVE_FROM(m), moves);
+    for (i = 0; i < n; i++)
+        if (MOVE_TO(moves[i]) == MOVE_TO(m))
+            return 1;
+    return 0;
+}
+
+static uint8_t back_to_start(session *s)
+{
+    char fen[FEN_MAX];
+    while (session_undo(s))
+        ;
+    session_fen(s, fen);
+    return strcmp(fen, START_FEN) == 0;
+}
+
+static void *run(void *arg)
+{
+    worker *w = arg;
+    session_slot *slots = malloc(w->games * sizeof(session_slot));
+    session **games = malloc(w->games * sizeof(session *));
+    session_pool pool;
+    uint32_t i;
+    int round;
+
+    session_pool_init(&pool, slots, w->games);
+    for (i = 0; i < w->games; i++)
+        games[i] = session_open(&pool, START_FEN);
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < w->games; i++) {
+            session *s = games[i];
+            packed_move m = next_random(&w->seed) & 0x0FFF;
+            uint8_t listed = is_listed(s, m);
+
+            w->validated++;
+            if (session_move(s, m)) {
+                w->accepted++;
+                if (!listed)
+                    w->wrong++;
+            } else if (listed) {
+                w->wrong++;
+            }
+
+            /* No legal move: mate or stalemate */
+            uint8_t over = !random_move(s, &w->seed, &m);
+            if (!over) {
+                w->validated++;
+                if (session_move(s, m))
+                    w->accepted++;
+                else
+                    w->wrong++;
+            }
+
+            if (over || s->history.current >= max_plies) {
+                if (!back_to_start(s))
+                    w->wrong++;
+                session_close(&pool, s);
+                games[i] = session_open(&pool, START_FEN);
+                w->finished++;
+            }
+        }
+    }
+
+    for (i = 0; i < w->games; i++)
+        session_close(&pool, games[i]);
+    if (pool.used)
+        w->wrong++;
+    free(games);
+    free(slots);
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: loadtest [-g games] [-j threads] [-r rounds] [-p plies]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    static worker workers[MAX_THREADS];
+    long games = 20000;
+    int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    struct timespec start, end;
+    uint64_t validated = 0, accepted = 0, wrong = 0, finished = 0;
+    double seconds;
+    int i, opt;
+
+    while ((opt = getopt(argc, argv, "g:j:r:p:")) != -1) {
+        switch (opt) {
+        case 'g':
+            games = atol(optarg);
+            break;
+        case 'j':
+            thread_count = atoi(optarg);
+            break;
+        case 'r':
+            rounds = atoi(optarg);
+            break;
+        case 'p':
+            max_plies = atoi(optarg);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc || games < 1 || max_plies < 1 || max_plies >= HISTORY_SIZE)
+        usage();
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MAX_THREADS)
+        thread_count = MAX_THREADS;
+    if (thread_count > games)
+        thread_count = games;
+    while ((games + thread_count - 1) / thread_count > MAX_POOL && thread_count < MAX_THREADS)
+        thread_count++;
+
+    printf("%ld games on %d threads, %d rounds, %zu bytes per game (position %zu, history %zu), %.1f MB\n",
+           games, thread_count, rounds, sizeof(session_slot), sizeof(game_state), sizeof(move_history),
+           games * sizeof(session_slot) / 1048576.0);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < thread_count; i++) {
+        workers[i].games = games / thread_count + (i < games % thread_count);
+        workers[i].seed = 2463534242u + i;
+        pthread_create(&workers[i].thread, NULL, run, &workers[i]);
+    }
+    for (i = 0; i < thread_count; i++) {
+        pthread_join(workers[i].thread, NULL);
+        validated += workers[i].validated;
+        accepted += workers[i].accepted;
+        wrong += workers[i].wrong;
+        finished += workers[i].finished;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%llu moves validated, %llu legal, %llu games finished and replaced\n",
+           (unsigned long long)validated, (unsigned long long)accepted, (unsigned long long)finished);
+    printf("%.1f s, %.0f moves validated/s\n", seconds, seconds > 0 ? validated / seconds : 0);
+    printf("%s: %llu wrong\n", wrong ? "FAILED" : "ok", (unsigned long long)wrong);
+
+    return wrong != 0;
+}
@@ -0,0 +1,403 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Host tool: engine against engine matches for tuning. Two players, each a
+ *  search depth, a time per move and a set of piece values, play every
+ *  opening from a file of FENs (or EPD lines) once with each colour. Games
+ *  run in parallel, one thread per core by default, each thread with its
+ *  own search contexts. The result is the Elo difference of player A over
+ *  player B with a 95% interval, and an SPRT of elo0 against elo1.
+ *
+ *      gcc -O2 -pthread -I. -o match match.c engine.c rules.c fen.c repetition.c profile.c -lm
+ *      ./match -o openings.epd -a depth=3 -b depth=3,n=300,b=350
+ *
+ *  -a spec, -b spec    players: depth=N, movetime=ms, and p n b r q for
+ *                      piece values in centipawns, comma separated
+ *  -o file             openings, one per line (default: the start position)
+ *  -n games            games to play (default: two per opening)
+ *  -j threads          games at once (default: one per core)
+ *  -p plies            a game this long is a draw (default 300)
+ *  -m cp               a material lead this large for 8 plies wins (default 1000, 0 off)
+ *  -e elo0,elo1        SPRT hypotheses (default 0,5), alpha = beta = 0.05
+ *  -s                  stop once the SPRT has decided
+ *  -v                  a line per game
+ *
+ *  Games are also adjudicated on mate, stalemate, the fifty move rule,
+ *  threefold repetition and material neither side can mate with.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "chess.h"
+#include "rules.h"
+#include "fen.h"
+#include "engine.h"
+#include "profile.h"
+
+#define MAX_OPENINGS    4096
+#define MAX_PLIES       1024
+#define MAX_THREADS     256
+#define MARGIN_PLIES    8
+#define SPRT_ALPHA      0.05
+#define SPRT_BETA       0.05
+
+enum { END_MATE, END_STALEMATE, END_FIFTY, END_REPETITION, END_MATERIAL, END_MARGIN, END_LENGTH, END_REASONS };
+
+static const char * const reasons[END_REASONS] = {
+    "mate", "stalemate", "fifty moves", "repetition", "insufficient material", "material lead", "length"
+};
+
+typedef struct {
+    uint8_t depth;
+    uint32_t movetime;          /* ms, 0 for no limit */
+    int16_t values[6];          /* indexed by (type-1)%6 */
+} player;
+
+static player players[2];
+static char (*openings)[FEN_MAX];
+static int opening_count;
+static int max_plies = 300;
+static int margin = 1000;
+static int verbose;
+static int stop_on_sprt;
+static double elo0 = 0, elo1 = 5;
+
+/* Shared between the threads, under lock */
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static int games, next_game;
+static int wins, draws, losses;             /* for player A */
+static int ends[END_REASONS];
+static int decided;
+
+static int parse_player(player *p, char *spec)
+{
+    static const char letters[6] = {'p', 'r', 'n', 'b', 'q', 'k'};
+    char *item;
+
+    for (item = strtok(spec, ","); item; item = strtok(NULL, ",")) {
+        char *equals = strchr(item, '=');
+        int i;
+        if (!equals)
+            return 0;
+        *equals = '\0';
+        if (strcmp(item, "depth") == 0) {
+            p->depth = atoi(equals + 1);
+        } else if (strcmp(item, "movetime") == 0) {
+            p->movetime = atol(equals + 1);
+        } else if (strlen(item) == 1 && strchr("pnbrq", item[0])) {
+            for (i = 0; letters[i] != item[0]; i++)
+                ;
+            p->values[i] = atoi(equals + 1);
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void read_openings(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[256];
+    game_state g;
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    openings = malloc(MAX_OPENINGS * sizeof(*openings));
+    while (fgets(line, sizeof(line), f) && opening_count < MAX_OPENINGS) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#')
+            continue;
+        memset(&g, 0, sizeof(g));
+        if (!fen_read(line, &g)) {
+            fprintf(stderr, "skipping bad FEN: %s\n", line);
+            continue;
+        }
+        fen_write(&g, openings[opening_count++]);
+    }
+    fclose(f);
+}
+
+/* Neither side has a pawn, rook or queen, and there is one minor piece at most */
+static uint8_t insufficient_material(game_state *g)
+{
+    uint8_t i, minors = 0;
+    for (i = 0; i < 32; i++) {
+        uint8_t kind = (g->pieces[i].type - 1) % 6;
+        if (g->pieces[i].taken || kind == 5)
+            continue;
+        if (kind == 2 || kind == 3)
+            minors++;
+        else
+            return 0;
+    }
+    return minors <= 1;
+}
+
+/* Material for white with the default values */
+static int material(game_state *g)
+{
+    int score = 0;
+    uint8_t i;
+    for (i = 0; i < 32; i++) {
+        if (g->pieces[i].taken)
+            continue;
+        score += g->pieces[i].team ? -engine_values[(g->pieces[i].type - 1) % 6]
+                                   : engine_values[(g->pieces[i].type - 1) % 6];
+    }
+    return score;
+}
+
+/* Game n: opening n/2, player A white on even n. Returns A's score in half points. */
+static int play_game(int n, search_context contexts[2], int *end, int *plies)
+{
+    int a_white = n % 2 == 0, lead = 0, ply, draw, result = -1;
+    key_stack keys;
+    game_state g;
+
+    memset(&g, 0, sizeof(g));
+    fen_read(openings[(n / 2) % opening_count], &g);
+    repetition_clear(&keys, &g);
+
+    for (ply = 0; result < 0; ply++) {
+        /* contexts[0] is player A */
+        search_context *c = &contexts[(g.turn == 0) != a_white];
+        uint8_t white_to_move = g.turn == 0;
+        packed_move m;
+
+        c->keys = &keys;
+        m = search(c, g);
+
+        if (m == ENGINE_NO_MOVE) {
+            if (check_in_check(g)) {
+                *end = END_MATE;
+                result = white_to_move != a_white ? 2 : 0;
+            } else {
+                *end = END_STALEMATE;
+                result = 1;
+            }
+            break;
+        }
+        g = play_move(g, m);
+        repetition_push(&keys, &g);
+        draw = repetition_draw(&keys, g.halfmove_clock, 3);
+
+        /* Plies in a row with white (positive) or black (negative) that far ahead */
+        int score = material(&g);
+        if (margin && score >= margin)
+            lead = lead > 0 ? lead + 1 : 1;
+        else if (margin && score <= -margin)
+            lead = lead < 0 ? lead - 1 : -1;
+        else
+            lead = 0;
+
+        if (draw == DRAW_FIFTY) {
+            *end = END_FIFTY;
+            result = 1;
+        } else if (draw == DRAW_REPETITION) {
+            *end = END_REPETITION;
+            result = 1;
+        } else if (insufficient_material(&g)) {
+            *end = END_MATERIAL;
+            result = 1;
+        } else if (abs(lead) >= MARGIN_PLIES) {
+            *end = END_MARGIN;
+            result = (lead > 0) == a_white ? 2 : 0;
+        } else if (ply + 1 >= max_plies || ply + 1 >= MAX_PLIES) {
+            *end = END_LENGTH;
+            result = 1;
+        }
+    }
+
+    *plies = ply;
+    return result;
+}
+
+/* Expected score for an Elo difference, and back */
+static double expected(double elo)
+{
+    return 1 / (1 + pow(10, -elo / 400));
+}
+
+static double elo_for(double score)
+{
+    if (score <= 0)
+        return -INFINITY;
+    if (score >= 1)
+        return INFINITY;
+    return -400 * log10(1 / score - 1);
+}
+
+/* Mean and per-game variance of A's score */
+static void score_stats(int w, int d, int l, double *mean, double *variance)
+{
+    int n = w + d + l;
+    double s = n ? (w + 0.5 * d) / n : 0.5;
+    *mean = s;
+    *variance = n ? (w * (1 - s) * (1 - s) + d * (0.5 - s) * (0.5 - s) + l * s * s) / n : 0;
+}
+
+/* Log likelihood ratio of elo1 over elo0, normal approximation */
+static double sprt_llr(int w, int d, int l)
+{
+    double s, variance, s0 = expected(elo0), s1 = expected(elo1);
+    score_stats(w, d, l, &s, &variance);
+    if (variance <= 0)
+        return 0;
+    return (w + d + l) * (s1 - s0) * (2 * s - s0 - s1) / (2 * variance);
+}
+
+static void *worker(void *unused)
+{
+    search_context contexts[2];
+    uint8_t k;
+
+    for (k = 0; k < 2; k++) {
+        search_init(&contexts[k], players[k].movetime * PROFILE_TICKS_PER_SECOND / 1000, players[k].depth);
+        contexts[k].values = players[k].values;
+    }
+
+    for (;;) {
+        int n, end, plies, result;
+
+        pthread_mutex_lock(&lock);
+        n = decided && stop_on_sprt ? games : next_game++;
+        pthread_mutex_unlock(&lock);
+        if (n >= games)
+            break;
+
+        result = play_game(n, contexts, &end, &plies);
+
+        pthread_mutex_lock(&lock);
+        if (result == 2)
+            wins++;
+        else if (result == 1)
+            draws++;
+        else
+            losses++;
+        ends[end]++;
+        double llr = sprt_llr(wins, draws, losses);
+        if (llr >= log((1 - SPRT_BETA) / SPRT_ALPHA) || llr <= log(SPRT_BETA / (1 - SPRT_ALPHA)))
+            decided = 1;
+        if (verbose)
+            printf("game %d: A %s, %s, %s in %d plies\n", n + 1, n % 2 == 0 ? "white" : "black",
+                   result == 2 ? "A wins" : result == 1 ? "draw" : "B wins", reasons[end], plies);
+        pthread_mutex_unlock(&lock);
+    }
+
+    return unused;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: match [-a spec] [-b spec] [-o openings] [-n games] [-j threads]"
+                    " [-p plies] [-m cp] [-e elo0,elo1] [-s] [-v]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    pthread_t threads[MAX_THREADS];
+    int thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+    struct timespec start, end;
+    double s, variance, se, llr, minutes;
+    int i, opt, played;
+    char start_fen[] = START_FEN;
+
+    for (i = 0; i < 2; i++) {
+        players[i].depth = 3;
+        players[i].movetime = 0;
+        memcpy(players[i].values, engine_values, sizeof(engine_values));
+    }
+
+    while ((opt = getopt(argc, argv, "a:b:o:n:j:p:m:e:sv")) != -1) {
+        switch (opt) {
+        case 'a':
+        case 'b':
+            if (!parse_player(&players[opt - 'a'], optarg))
+                usage();
+            break;
+        case 'o':
+            read_openings(optarg);
+            break;
+        case 'n':
+            games = atoi(optarg);
+            break;
+        case 'j':
+            thread_count = atoi(optarg);
+            break;
+        case 'p':
+            max_plies = atoi(optarg);
+            break;
+        case 'm':
+            margin = atoi(optarg);
+            break;
+        case 'e':
+            if (sscanf(optarg, "%lf,%lf", &elo0, &elo1) != 2)
+                usage();
+            break;
+        case 's':
+            stop_on_sprt = 1;
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+        usage();
+
+    if (opening_count == 0) {
+        openings = malloc(sizeof(*openings));
+        strcpy(openings[0], start_fen);
+        opening_count = 1;
+    }
+    if (games <= 0)
+        games = 2 * opening_count;
+    if (thread_count < 1)
+        thread_count = 1;
+    if (thread_count > MAX_THREADS)
+        thread_count = MAX_THREADS;
+    if (thread_count > games)
+        thread_count = games;
+
+    printf("%d games from %d openings on %d threads\n", games, opening_count, thread_count);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < thread_count; i++)
+        pthread_create(&threads[i], NULL, worker, NULL);
+    for (i = 0; i < thread_count; i++)
+        pthread_join(threads[i], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    played = wins + draws + losses;
+    minutes = (end.tv_sec - start.tv_sec + (end.tv_nsec - start.tv_nsec) / 1e9) / 60;
+    score_stats(wins, draws, losses, &s, &variance);
+    se = played ? sqrt(variance / played) : 0;
+    llr = sprt_llr(wins, draws, losses);
+
+    printf("A: +%d =%d -%d, score %.1f%%\n", wins, draws, losses, 100 * s);
+    printf("Elo difference: %+.1f +/- %.1f (95%%)\n", elo_for(s),
+           (elo_for(s + 1.96 * se) - elo_for(s - 1.96 * se)) / 2);
+    printf("SPRT elo0 %.1f elo1 %.1f: LLR %.2f [%.2f, %.2f], %s\n", elo0, elo1, llr,
+           log(SPRT_BETA / (1 - SPRT_ALPHA)), log((1 - SPRT_BETA) / SPRT_ALPHA),
+           llr >= log((1 - SPRT_BETA) / SPRT_ALPHA) ? "H1 accepted" :
+           llr <= log(SPRT_BETA / (1 - SPRT_ALPHA)) ? "H0 accepted" : "no decision");
+    printf("endings:");
+    for (i = 0; i < END_REASONS; i++)
+        if (ends[i])
+            printf(" %s %d", reasons[i], ends[i]);
+    printf("\n%d games in %.1f s, %.1f games/minute\n", played, minutes * 60, minutes > 0 ? played / minutes : 0);
+
+    return 0;
+}
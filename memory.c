@@ -0,0 +1,62 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include <string.h>
+
+#ifdef __AVR__
+#include <avr/io.h>
+#endif
+
+#include "memory.h"
+
+#ifdef __AVR__
+
+extern uint8_t __data_start, __data_end, __bss_start, __bss_end, __heap_start;
+extern char *__brkval;
+
+/* Runs from .init1, before the stack pointer is set up or anything is
+ * called, so it must not use the stack: _end up to and including __stack */
+void memory_paint(void) __attribute__((naked, used, section(".init1")));
+void memory_paint(void)
+{
+    asm volatile (
+        "    ldi r30, lo8(_end)     \n"
+        "    ldi r31, hi8(_end)     \n"
+        "    ldi r24, %0            \n"
+        "    ldi r25, hi8(__stack)  \n"
+        "    rjmp 2f                \n"
+        "1:  st Z+, r24             \n"
+        "2:  cpi r30, lo8(__stack)  \n"
+        "    cpc r31, r25           \n"
+        "    brlo 1b                \n"
+        "    breq 1b                \n"
+        :: "M" (MEMORY_PAINT));
+}
+
+void memory_read(memory_usage *m)
+{
+    uint8_t *low = __brkval ? (uint8_t *)__brkval : &__heap_start;
+    uint8_t *p = low;
+
+    /* The first changed byte above the heap is as deep as the stack has gone */
+    while (p <= (uint8_t *)RAMEND && *p == MEMORY_PAINT)
+        p++;
+
+    m->data = &__data_end - &__data_start;
+    m->bss = &__bss_end - &__bss_start;
+    m->heap = low - &__heap_start;
+    m->stack = RAMEND - SP;
+    m->stack_deepest = (uint8_t *)RAMEND + 1 - p;
+    m->never_used = p - low;
+}
+
+#else
+
+void memory_read(memory_usage *m)
+{
+    memset(m, 0, sizeof(*m));
+}
+
+#endif
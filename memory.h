@@ -0,0 +1,31 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Where the 8K of SRAM goes. Section sizes come from the linker symbols.
+ *  Before anything runs, everything between the end of .bss and the top of
+ *  RAM is painted with MEMORY_PAINT. The deepest the stack has been since
+ *  reset is then the highest painted byte that has changed. The host has
+ *  no such layout, so there every figure is 0; use stackuse there instead.
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdint.h>
+
+#define MEMORY_PAINT    0xC5
+#define MEMORY_SRAM     8192        /* AT90USB1286, 0x0100 to RAMEND */
+
+typedef struct {
+    uint16_t data;          /* initialised globals */
+    uint16_t bss;           /* zeroed globals */
+    uint16_t heap;          /* malloc, 0 while it is never used */
+    uint16_t stack;         /* in use now */
+    uint16_t stack_deepest; /* high-water mark since reset */
+    uint16_t never_used;    /* painted bytes still intact between heap and stack */
+} memory_usage;
+
+void memory_read(memory_usage *m);
+
+#endif
@@ -0,0 +1,98 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Host tool: counts the positions reachable in N plies from a FEN, using
+ *  the same rules code as the game, and times it.
+ *
+ *      gcc -O2 -I. -o perft perft.c rules.c fen.c
+ *      ./perft [depth] [fen]
+ *      ./perft -d [depth] [fen]        (divide: count per first move)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chess.h"
+#include "rules.h"
+#include "fen.h"
+
+static uint8_t is_promotion(piece p, uint8_t y)
+{
+    return (p.type == 1 && y == 0) || (p.type == 7 && y == 7);
+}
+
+static uint64_t perft(game_state g, uint8_t depth, uint8_t divide)
+{
+    uint64_t nodes = 0;
+    uint8_t i, j, k;
+
+    if (depth == 0)
+        return 1;
+
+    for (i = 0; i < 32; i++) {
+        piece p = g.pieces[i];
+        if (p.taken || p.team != g.turn)
+            continue;
+
+        move_set m = get_possible_moves_for_piece(p, g);
+        for (j = 0; j < m.num_possible_moves; j++) {
+            uint8_t x = m.possible_moves_x[j], y = m.possible_moves_y[j];
+            uint64_t n = 0;
+            if (x == p.x && y == p.y)
+                continue;           /* putting the piece back is not a move */
+
+            game_state next = make_move(g, i, x, y);
+            if (is_promotion(p, y)) {
+                for (k = PROMOTE_KNIGHT; k <= PROMOTE_QUEEN; k++)
+                    n += perft(promote_piece(next, i, k), depth - 1, 0);
+            } else {
+                n = perft(next, depth - 1, 0);
+            }
+
+            if (divide)
+                printf("%c%d%c%d: %llu\n", 'a' + p.x, 8 - p.y, 'a' + x, 8 - y, (unsigned long long)n);
+            nodes += n;
+        }
+    }
+
+    return nodes;
+}
+
+int main(int argc, char **argv)
+{
+    game_state g;
+    uint8_t divide = 0, depth = 3, d;
+    const char *fen = START_FEN;
+    char out[FEN_MAX];
+
+    if (argc > 1 && strcmp(argv[1], "-d") == 0) {
+        divide = 1;
+        argv++;
+        argc--;
+    }
+    if (argc > 1)
+        depth = atoi(argv[1]);
+    if (argc > 2)
+        fen = argv[2];
+
+    memset(&g, 0, sizeof(g));
+    if (!fen_read(fen, &g)) {
+        fprintf(stderr, "bad FEN: %s\n", fen);
+        return 1;
+    }
+    fen_write(&g, out);
+    printf("%s\n", out);
+
+    for (d = divide ? depth : 1; d <= depth; d++) {
+        clock_t start = clock();
+        uint64_t nodes = perft(g, d, divide);
+        double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+        printf("depth %u: %llu nodes, %.3f s, %.0f nodes/s\n", d, (unsigned long long)nodes,
+               seconds, seconds > 0 ? nodes / seconds : 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,247 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include <string.h>
+
+#include "pgn.h"
+#include "rules.h"
+#include "fen.h"
+#include "uart.h"
+
+/* Indexed by (type-1)%6 */
+static const char letters[6] = {'P', 'R', 'N', 'B', 'Q', 'K'};
+/* Indexed by PROMOTE_KNIGHT..PROMOTE_QUEEN */
+static const char promotion_letters[4] = {'N', 'B', 'R', 'Q'};
+
+void pgn_flush(pgn_sink *s)
+{
+    if (s->used)
+        s->write(s, s->chunk, s->used);
+    s->used = 0;
+}
+
+void pgn_put(pgn_sink *s, char c)
+{
+    s->chunk[s->used++] = c;
+    s->column = c == '\n' ? 0 : s->column + 1;
+    if (s->used == PGN_CHUNK)
+        pgn_flush(s);
+}
+
+static void pgn_text(pgn_sink *s, const char *text)
+{
+    while (*text)
+        pgn_put(s, *text++);
+}
+
+/* A movetext token, on a new line if it would run past PGN_COLUMNS */
+static void pgn_token(pgn_sink *s, const char *token)
+{
+    uint8_t length = strlen(token);
+    if (s->column && s->column + 1 + length > PGN_COLUMNS)
+        pgn_put(s, '\n');
+    else if (s->column)
+        pgn_put(s, ' ');
+    pgn_text(s, token);
+}
+
+static void pgn_tag(pgn_sink *s, const char *name, const char *value)
+{
+    pgn_put(s, '[');
+    pgn_text(s, name);
+    pgn_text(s, " \"");
+    pgn_text(s, value);
+    pgn_text(s, "\"]\n");
+}
+
+/* "12." or "12..." without printf */
+static void move_number(char *text, uint16_t number, uint8_t black)
+{
+    char digits[6];
+    uint8_t n = 0;
+    do {
+        digits[n++] = '0' + number % 10;
+        number /= 10;
+    } while (number);
+    while (n)
+        *text++ = digits[--n];
+    *text++ = '.';
+    if (black) {
+        *text++ = '.';
+        *text++ = '.';
+    }
+    *text = '\0';
+}
+
+static uint8_t can_reach(game_state g, uint8_t index, uint8_t x, uint8_t y)
+{
+    move_set m = get_possible_moves_for_piece(g.pieces[index], g);
+    uint8_t i;
+    for (i = 0; i < m.num_possible_moves; i++)
+        if (m.possible_moves_x[i] == x && m.possible_moves_y[i] == y)
+            return 1;
+    return 0;
+}
+
+/* SAN for m played from g. status is check_checkmate() of the position
+ * after the move: 1 adds '+', 2 adds '#'. Returns the length written. */
+uint8_t san_write(game_state g, packed_move m, uint8_t status, char *san)
+{
+    uint8_t from_x = MOVE_FROM(m) % 8, from_y = MOVE_FROM(m) / 8;
+    uint8_t to_x = MOVE_TO(m) % 8, to_y = MOVE_TO(m) / 8;
+    uint8_t index = get_piece_index_at(from_x, from_y, g);
+    uint8_t type = g.pieces[index].type;
+    uint8_t kind = (type - 1) % 6;
+    uint8_t capture = MOVE_FLAGS(m) == MOVE_EN_PASSANT || get_piece_index_at(to_x, to_y, g) != 32;
+    char *c = san;
+
+    if (MOVE_FLAGS(m) == MOVE_CASTLE) {
+        strcpy(c, to_x == 6 ? "O-O" : "O-O-O");
+        c += strlen(c);
+    } else {
+        if (kind == 0) {
+            if (capture)
+                *c++ = 'a' + from_x;
+        } else {
+            *c++ = letters[kind];
+            if (type != 6 && type != 12) {
+                /* Only pieces of the same kind that can legally get there count */
+                uint8_t i, ambiguous = 0, same_file = 0, same_rank = 0;
+                for (i = 0; i < 32; i++) {
+                    if (i == index || g.pieces[i].taken || g.pieces[i].type != type)
+                        continue;
+                    if (!can_reach(g, i, to_x, to_y))
+                        continue;
+                    ambiguous = 1;
+                    if (g.pieces[i].x == from_x)
+                        same_file = 1;
+                    if (g.pieces[i].y == from_y)
+                        same_rank = 1;
+                }
+                if (ambiguous && (!same_file || same_rank))
+                    *c++ = 'a' + from_x;
+                if (ambiguous && same_file)
+                    *c++ = '8' - from_y;
+            }
+        }
+        if (capture)
+            *c++ = 'x';
+        *c++ = 'a' + to_x;
+        *c++ = '8' - to_y;
+        if (MOVE_FLAGS(m) == MOVE_PROMOTION) {
+            *c++ = '=';
+            *c++ = promotion_letters[MOVE_PROMOTES_TO(m)];
+        }
+    }
+
+    if (status == 1)
+        *c++ = '+';
+    if (status == 2)
+        *c++ = '#';
+    *c = '\0';
+
+    return c - san;
+}
+
+/* The game from the oldest ply still in h up to the current position g.
+ * Plies left for redo are not written. */
+void pgn_write_game(pgn_sink *s, game_state g, move_history *h)
+{
+    char fen[FEN_MAX];
+    char token[SAN_MAX];
+    const char *result = "*";
+    uint16_t ply;
+
+    /* Result from the position reached */
+    uint8_t status = check_checkmate(g);
+    if (status == 2)
+        result = g.turn ? "1-0" : "0-1";
+    else if (status == 0 && !are_there_possible_moves(g))
+        result = "1/2-1/2";
+
+    /* Walk back to where the history starts */
+    for (ply = h->current; ply != h->oldest; ply--)
+        g = unmake_move(g, history_ply(h, ply - 1), history_undo_record(h, ply - 1));
+
+    s->column = 0;
+    pgn_tag(s, "Event", "Casual game");
+    pgn_tag(s, "Site", "LaFortuna");
+    pgn_tag(s, "Date", "????.??.??");
+    pgn_tag(s, "Round", "-");
+    pgn_tag(s, "White", "White");
+    pgn_tag(s, "Black", "Black");
+    pgn_tag(s, "Result", result);
+    fen_write(&g, fen);
+    if (strcmp(fen, START_FEN) != 0) {
+        pgn_tag(s, "SetUp", "1");
+        pgn_tag(s, "FEN", fen);
+    }
+    pgn_put(s, '\n');
+
+    for (ply = h->oldest; ply != h->current; ply++) {
+        packed_move m = history_ply(h, ply);
+        game_state next = play_move(g, m);
+
+        if (g.turn == 0 || ply == h->oldest) {
+            move_number(token, g.fullmove_number, g.turn);
+            pgn_token(s, token);
+        }
+        san_write(g, m, check_checkmate(next), token);
+        pgn_token(s, token);
+
+        g = next;
+    }
+
+    pgn_token(s, result);
+    pgn_put(s, '\n');
+    pgn_flush(s);
+}
+
+
+
+#ifdef __AVR__
+
+/* An export is asked for and may wait on the line, unlike UCI replies */
+static void serial_write(pgn_sink *s, const char *chunk, uint8_t length)
+{
+    while (length) {
+        if (uart_putc(*chunk)) {
+            chunk++;
+            length--;
+        }
+    }
+}
+
+void pgn_serial_open(pgn_sink *s)
+{
+    s->write = serial_write;
+    s->ctx = 0;
+    s->used = 0;
+    s->column = 0;
+}
+
+/* Waits for the last byte to leave */
+void pgn_serial_close(pgn_sink *s)
+{
+    pgn_flush(s);
+    uart_flush();
+}
+
+#else
+
+static void file_write(pgn_sink *s, const char *chunk, uint8_t length)
+{
+    fwrite(chunk, 1, length, (FILE *)s->ctx);
+}
+
+void pgn_file_open(pgn_sink *s, FILE *f)
+{
+    s->write = file_write;
+    s->ctx = f;
+    s->used = 0;
+    s->column = 0;
+}
+
+#endif
@@ -0,0 +1,42 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Standard Algebraic Notation and a streaming PGN writer. Moves go out one
+ *  token at a time through a small chunk buffer, so the game text is never
+ *  held in RAM. The sink is a file on the host and the UART on the board.
+ */
+
+#ifndef PGN_H
+#define PGN_H
+
+#include "chess.h"
+#include "history.h"
+
+#define SAN_MAX     8       /* "Qa1xb2#" or "exd8=Q#" plus terminator */
+#define PGN_CHUNK   16      /* bytes buffered before the sink is called */
+#define PGN_COLUMNS 79      /* movetext is wrapped to this width */
+
+typedef struct pgn_sink {
+    void (*write)(struct pgn_sink *s, const char *chunk, uint8_t length);
+    void *ctx;
+    char chunk[PGN_CHUNK];
+    uint8_t used;
+    uint8_t column;
+} pgn_sink;
+
+void pgn_put(pgn_sink *s, char c);
+void pgn_flush(pgn_sink *s);
+
+uint8_t san_write(game_state g, packed_move m, uint8_t status, char *san);
+void pgn_write_game(pgn_sink *s, game_state g, move_history *h);
+
+#ifdef __AVR__
+void pgn_serial_open(pgn_sink *s);
+void pgn_serial_close(pgn_sink *s);
+#else
+#include <stdio.h>
+void pgn_file_open(pgn_sink *s, FILE *f);
+#endif
+
+#endif
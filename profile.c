@@ -0,0 +1,89 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#ifdef __AVR__
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#else
+#include <stdio.h>
+#include <time.h>
+#endif
+#include "profile.h"
+
+profile_entry profile_entries[PROF_SECTIONS];
+const char *profile_names[PROF_SECTIONS] = {
+    "switches", "checkmate", "moves", "refresh_tile", "draw_piece"
+};
+
+/* Whole seconds counted by ISR(TIMER3_COMPA_vect) */
+static volatile uint32_t profile_seconds;
+
+void profile_second(void)
+{
+    profile_seconds++;
+}
+
+#ifdef __AVR__
+uint32_t profile_now(void)
+{
+    uint8_t sreg = SREG;
+    uint32_t s;
+    uint16_t t;
+
+    cli();
+    s = profile_seconds;
+    t = TCNT3;
+    /* Counter already wrapped but the compare ISR has not run yet */
+    if ((TIFR3 & _BV(OCF3A)) && t < PROFILE_TICKS_PER_SECOND/2)
+        s++;
+    SREG = sreg;
+
+    return s * PROFILE_TICKS_PER_SECOND + t;
+}
+#else
+uint32_t profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * PROFILE_TICKS_PER_SECOND
+         + ts.tv_nsec / (PROFILE_US_PER_TICK * 1000L);
+}
+#endif
+
+void profile_record(uint8_t id, uint32_t ticks)
+{
+    profile_entry *e = &profile_entries[id];
+    uint16_t t = ticks > 0xFFFF ? 0xFFFF : ticks;
+
+    if (e->calls == 0xFFFF)
+        return;                         /* keep the average meaningful */
+    if (e->calls == 0 || t < e->min)
+        e->min = t;
+    if (t > e->max)
+        e->max = t;
+    e->total += ticks;
+    e->calls++;
+}
+
+uint16_t profile_average(uint8_t id)
+{
+    profile_entry *e = &profile_entries[id];
+    return e->calls ? e->total / e->calls : 0;
+}
+
+#ifndef __AVR__
+void profile_dump(void)
+{
+    uint8_t i;
+    printf("%-12s %6s %8s %8s %8s (us)\n", "section", "calls", "min", "avg", "max");
+    for (i = 0; i < PROF_SECTIONS; i++) {
+        profile_entry *e = &profile_entries[i];
+        printf("%-12s %6u %8lu %8lu %8lu\n", profile_names[i], e->calls,
+               (unsigned long)e->min * PROFILE_US_PER_TICK,
+               (unsigned long)profile_average(i) * PROFILE_US_PER_TICK,
+               (unsigned long)e->max * PROFILE_US_PER_TICK);
+    }
+}
+#endif
@@ -0,0 +1,51 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Section timing on Timer 3 (clk/256, 32us per tick, compare match once a
+ *  second). PROFILE_BEGIN/PROFILE_END compile to nothing unless PROFILE is
+ *  defined, so release builds carry no cost beyond the seconds counter.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#define PROFILE_TICKS_PER_SECOND    31250UL     /* 8MHz / 256 */
+#define PROFILE_US_PER_TICK         32
+
+/* Profiled sections */
+#define PROF_CHECK_SWITCHES     0
+#define PROF_CHECK_CHECKMATE    1
+#define PROF_GET_MOVES          2
+#define PROF_REFRESH_TILE       3
+#define PROF_DRAW_PIECE         4
+#define PROF_SECTIONS           5
+
+typedef struct {
+    uint16_t calls;
+    uint16_t min, max;          /* ticks, saturating */
+    uint32_t total;             /* ticks */
+} profile_entry;
+
+extern profile_entry profile_entries[PROF_SECTIONS];
+extern const char *profile_names[PROF_SECTIONS];
+
+void profile_second(void);
+uint32_t profile_now(void);
+void profile_record(uint8_t id, uint32_t ticks);
+uint16_t profile_average(uint8_t id);
+#ifndef __AVR__
+void profile_dump(void);
+#endif
+
+#ifdef PROFILE
+#define PROFILE_BEGIN(id)   uint32_t profile_start_##id = profile_now()
+#define PROFILE_END(id)     profile_record((id), profile_now() - profile_start_##id)
+#else
+#define PROFILE_BEGIN(id)
+#define PROFILE_END(id)
+#endif
+
+#endif
@@ -0,0 +1,86 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include "repetition.h"
+
+#define SLOT(ply)   ((ply) & (REPETITION_SIZE - 1))
+
+/* A bijection, so no two pieces on squares mix to the same word */
+static uint32_t mix(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352DUL;
+    x ^= x >> 15;
+    x *= 0x846CA68BUL;
+    x ^= x >> 16;
+    return x;
+}
+
+/* Pieces with their squares and first move flags (which hold the castling
+ * rights), the side to move and the en passant square */
+uint32_t position_key(game_state *g)
+{
+    uint32_t key = g->turn ? mix(0x10000UL) : 0;
+    uint8_t i;
+
+    for (i = 0; i < 32; i++) {
+        piece p = g->pieces[i];
+        if (!p.taken)
+            key ^= mix((uint32_t)(p.y*8 + p.x) << 8 | p.type << 1 | p.first);
+    }
+    if (g->can_en_passant)
+        key ^= mix(0x20000UL | (g->en_passant_y*8 + g->en_passant_x));
+    return key;
+}
+
+/* The game starts from g; whatever came before it is not known */
+void repetition_clear(key_stack *k, game_state *g)
+{
+    k->count = 0;
+    repetition_push(k, g);
+}
+
+/* g is the position after a move */
+void repetition_push(key_stack *k, game_state *g)
+{
+    k->keys[SLOT(k->count)] = position_key(g);
+    k->count++;
+}
+
+void repetition_pop(key_stack *k)
+{
+    k->count--;
+}
+
+/* Amend the newest position, e.g. once the promotion piece is chosen */
+void repetition_set_last(key_stack *k, game_state *g)
+{
+    k->keys[SLOT(k->count - 1)] = position_key(g);
+}
+
+/* Earlier times the newest position came up. Only the same side to move
+ * can match, four plies back at the nearest, and nothing before the last
+ * pawn move or capture */
+uint8_t repetition_count(key_stack *k, uint8_t halfmove_clock)
+{
+    uint32_t key = k->keys[SLOT(k->count - 1)];
+    uint8_t back, n = 0;
+
+    for (back = 4; back <= halfmove_clock && back < k->count && back < FIFTY_MOVE_PLIES && back <= REPETITION_REACH; back += 2)
+        if (k->keys[SLOT(k->count - 1 - back)] == key)
+            n++;
+    return n;
+}
+
+/* DRAW_FIFTY, DRAW_REPETITION when the newest position has come up times
+ * times in all, or DRAW_NONE */
+uint8_t repetition_draw(key_stack *k, uint8_t halfmove_clock, uint8_t times)
+{
+    if (halfmove_clock >= FIFTY_MOVE_PLIES)
+        return DRAW_FIFTY;
+    if (repetition_count(k, halfmove_clock) + 1 >= times)
+        return DRAW_REPETITION;
+    return DRAW_NONE;
+}
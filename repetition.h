@@ -0,0 +1,49 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Draws by repetition and the fifty move rule. A game keeps a 32-bit key
+ *  for each position it has been through, pushed when a move is made and
+ *  popped when it is taken back; the halfmove clock in the game_state says
+ *  how far back a repeat can be, since no position before the last pawn
+ *  move or capture can come again. The main loop asks for three times, the
+ *  search pushes its own moves on top and counts a second time as a draw.
+ */
+
+#ifndef REPETITION_H
+#define REPETITION_H
+
+#include "chess.h"
+
+/* Plies, power of two. On the host, more than the 100 the fifty move rule
+ * looks back plus the deepest search. The board has two of these and keeps
+ * them to 256 bytes each, so a repeat more than 60 plies back is missed */
+#ifdef __AVR__
+#define REPETITION_SIZE 64
+#else
+#define REPETITION_SIZE 128
+#endif
+/* Furthest back a repeat is looked for: the search on the board pushes up
+ * to three keys of its own, and they land on the oldest slots */
+#define REPETITION_REACH    (REPETITION_SIZE - 4)
+#define FIFTY_MOVE_PLIES 100
+
+#define DRAW_NONE       0
+#define DRAW_FIFTY      1
+#define DRAW_REPETITION 2
+
+typedef struct {
+    uint32_t keys[REPETITION_SIZE];
+    uint16_t count;             /* positions since the start, the newest at count-1 */
+} key_stack;
+
+uint32_t position_key(game_state *g);
+
+void repetition_clear(key_stack *k, game_state *g);
+void repetition_push(key_stack *k, game_state *g);
+void repetition_pop(key_stack *k);
+void repetition_set_last(key_stack *k, game_state *g);
+uint8_t repetition_count(key_stack *k, uint8_t halfmove_clock);
+uint8_t repetition_draw(key_stack *k, uint8_t halfmove_clock, uint8_t times);
+
+#endif
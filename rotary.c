@@ -3,46 +3,61 @@
  *           View this license at http://creativecommons.org/about/licenses/
  */
  
-#include <avr/io.h>
-#include <avr/interrupt.h>
-#include <util/delay.h>
+#include "hal.h"
 #include "rotary.h"
 
 volatile int8_t rotary = 0;
+static uint8_t lastAB = 0x00;
 
 void init_rotary()
 {
-	/* Ensure all pins are inputs with pull-ups enabled */
-	DDRE &= ~_BV(ROTA) & ~_BV(ROTB) & ~_BV(SWC);
-	PORTE |= _BV(ROTA) | _BV(ROTB) | _BV(SWC);
-	DDRC &= ~_BV(SWN) & ~_BV(SWE) & ~_BV(SWS) & ~_BV(SWW);
-	PORTC |= _BV(SWN) | _BV(SWE) | _BV(SWS) | _BV(SWW);
-	/* Configure interrupt for any edge on rotary and falling edge for button */
-	EICRB |= _BV(ISC40) | _BV(ISC50) | _BV(ISC71);
+	hal_rotary_init();
+	/* Start decoding from wherever the wheel is resting */
+	lastAB = hal_rotary_pins();
 }
 
+/* Quarter steps indexed by (previous AB << 2) | AB. Unchanged or invalid
+   (both pins flipped, i.e. contact bounce) transitions count as 0. */
+static const int8_t quadrature[16] = { 0, -1,  1,  0,
+                                       1,  0,  0, -1,
+                                      -1,  0,  0,  1,
+                                       0,  1, -1,  0};
+
 int8_t get_rotary()
 {
-	static uint8_t lastAB = 0x00;
-	uint8_t AB = PINE & (_BV(ROTA) | _BV(ROTB));
-	if ((AB == 0x00 && lastAB == 0x20) || (AB == 0x30 && lastAB == 0x10))
-		rotary--;
-	if ((AB == 0x30 && lastAB == 0x20) || (AB == 0x00 && lastAB == 0x10))
-		rotary++;
+	static int8_t quarters = 0;
+	uint8_t AB = hal_rotary_pins();
+	quarters += quadrature[(lastAB << 2) | AB];
 	lastAB = AB;
+	/* Two quarter steps per count, as before */
+	if (quarters >= 2) {
+		quarters -= 2;
+		rotary++;
+	} else if (quarters <= -2) {
+		quarters += 2;
+		rotary--;
+	}
 	return rotary;
 }
 
+int8_t get_rotary_delta()
+{
+	int8_t d;
+	cli();                         /* read and clear atomic! */
+	d = rotary;
+	rotary = 0;
+	sei();
+	return d;
+}
+
 uint8_t get_switch()
 {
-	return PINC & (_BV(SWN) | _BV(SWE) | _BV(SWS) | _BV(SWW));
+	return hal_switch_pins() & (_BV(SWN) | _BV(SWE) | _BV(SWS) | _BV(SWW));
 }
 
 ISR(INT4_vect)
 {
 	get_rotary();
-	_delay_us(100);
 }
 
 ISR(INT5_vect, ISR_ALIASOF(INT4_vect));
-
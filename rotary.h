@@ -17,5 +17,6 @@ extern volatile int8_t rotary;
 
 void init_rotary();
 int8_t get_rotary();
+int8_t get_rotary_delta();
 uint8_t get_switch();
 
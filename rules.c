@@ -0,0 +1,786 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include "rules.h"
+#include "profile.h"
+
+
+uint8_t get_piece_type_at(uint8_t temp_x, uint8_t temp_y, game_state g) {
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g.pieces[i].x==temp_x && g.pieces[i].y==temp_y && i!=g.selected_piece_index && g.pieces[i].taken==0) return g.pieces[i].type;
+    }
+
+    return 0;
+}
+
+uint8_t get_piece_first_state_at(uint8_t temp_x, uint8_t temp_y, game_state g) {
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g.pieces[i].x==temp_x && g.pieces[i].y==temp_y && i!=g.selected_piece_index && g.pieces[i].taken==0) return g.pieces[i].first;
+    }
+
+    return 0;
+}
+
+uint8_t get_piece_index_by_type(uint8_t type, uint8_t x, uint8_t y, game_state g) {
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g.pieces[i].x==x && g.pieces[i].y==y && g.pieces[i].taken==0 && g.pieces[i].type==type) return i;
+    }
+
+    return 0;
+}
+
+int8_t get_piece_index_in_game_state(piece p, game_state g) {
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g.pieces[i].x==p.x && g.pieces[i].y==p.y && g.pieces[i].taken==0 && g.pieces[i].type==p.type) return i;
+    }
+
+    return 0;
+}
+
+
+
+
+
+
+
+uint8_t calc_x_difference_from_past(uint8_t x, uint8_t p_x) {
+    if (x>p_x)
+        return x-p_x;
+    else
+        return p_x-x;
+}
+
+uint8_t calc_y_difference_from_past(uint8_t y, uint8_t p_y) {
+    if (y>p_y)
+        return y-p_y;
+    else
+        return p_y-y;
+}
+
+
+
+
+
+
+
+// TYPE ONLY BOARD: 0 FOR AN EMPTY SQUARE, OTHERWISE THE PIECE TYPE, INDEXED y*8+x
+// KIND: 0 (Pawn), 1 (Rook), 2 (Knight), 3 (Bishop), 4 (Queen), 5 (King). TEAM: AS piece.team
+#define KIND(type) (((type)-1)%6)
+#define TEAM(type) ((type)>6)
+
+// EVEN DIRECTIONS ARE ALONG A RANK OR FILE, ODD ONES ARE DIAGONAL
+static const int8_t ray_dx[8] = {0, 1, 1, 1, 0, -1, -1, -1};
+static const int8_t ray_dy[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+static const int8_t knight_dx[8] = {1, 2, 2, 1, -1, -2, -2, -1};
+static const int8_t knight_dy[8] = {2, 1, -1, -2, -2, -1, 1, 2};
+
+static void fill_squares(game_state *g, uint8_t squares[64]) {
+    uint8_t i;
+    for (i=0; i<64; i++) squares[i] = 0;
+    for (i=0; i<32; i++) {
+        if (g->pieces[i].taken==0) squares[g->pieces[i].y*8+g->pieces[i].x] = g->pieces[i].type;
+    }
+}
+
+static uint8_t on_board(int8_t x, int8_t y) {
+    return x>=0 && x<8 && y>=0 && y<8;
+}
+
+static uint8_t slides_along(uint8_t type, uint8_t dir) {
+    uint8_t kind = KIND(type);
+    return kind==4 || (kind==1 && (dir&1)==0) || (kind==3 && (dir&1));
+}
+
+static uint8_t walk(const uint8_t squares[64], int8_t *x, int8_t *y, uint8_t dir) {
+    // STEP FROM (x, y) TO THE FIRST PIECE ALONG dir AND RETURN ITS TYPE. 0 IF THE EDGE COMES FIRST, LEAVING (x, y) ON THE LAST SQUARE
+    do {
+        *x += ray_dx[dir];
+        *y += ray_dy[dir];
+        if (!on_board(*x, *y)) {
+            *x -= ray_dx[dir];
+            *y -= ray_dy[dir];
+            return 0;
+        }
+    } while (squares[*y*8+*x]==0);
+
+    return squares[*y*8+*x];
+}
+
+static void mark_ray(uint8_t mask[8], int8_t x, int8_t y, int8_t to_x, int8_t to_y, uint8_t dir) {
+    // SQUARES AFTER (x, y) UP TO AND INCLUDING (to_x, to_y). ONE BIT PER x IN EACH RANK
+    do {
+        x += ray_dx[dir];
+        y += ray_dy[dir];
+        mask[y] |= 1<<x;
+    } while (x!=to_x || y!=to_y);
+}
+
+static uint8_t is_attacked(const uint8_t squares[64], int8_t x, int8_t y, uint8_t team) {
+    // CAN ANY OF team'S PIECES TAKE ON (x, y)
+    uint8_t i, type;
+    int8_t tx, ty;
+
+    for (i=0; i<8; i++) {
+        tx = x;
+        ty = y;
+        type = walk(squares, &tx, &ty, i);
+        if (type && TEAM(type)==team) {
+            if (slides_along(type, i)) return 1;
+            if (KIND(type)==5 && tx-x<=1 && x-tx<=1 && ty-y<=1 && y-ty<=1) return 1;
+        }
+    }
+
+    for (i=0; i<8; i++) {
+        tx = x+knight_dx[i];
+        ty = y+knight_dy[i];
+        if (on_board(tx, ty) && squares[ty*8+tx]==(team ? 9 : 3)) return 1;
+    }
+
+    // WHITE PAWNS MOVE TOWARDS y=0, SO ONE ON y+1 TAKES ON y. BLACK ONES THE OTHER WAY
+    ty = team ? y-1 : y+1;
+    for (tx=x-1; tx<=x+1; tx+=2) {
+        if (on_board(tx, ty) && squares[ty*8+tx]==(team ? 7 : 1)) return 1;
+    }
+
+    return 0;
+}
+
+static uint8_t find_king(game_state *g, uint8_t team) {
+    // 32 IF THERE IS NO KING (A POSITION SET UP BY HAND)
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g->pieces[i].type==(team ? 12 : 6) && g->pieces[i].taken==0) return i;
+    }
+
+    return 32;
+}
+
+static uint8_t can_castle_with(uint8_t rook_x, piece p, game_state *g, const uint8_t squares[64]) {
+    // KING AND ROOK NOT YET MOVED, THE SQUARES BETWEEN EMPTY, AND THE KING NOT PASSING OVER OR ONTO AN ATTACKED SQUARE.
+    // CALLED ONLY WHEN NOT IN CHECK, WITH THE KING TAKEN OFF squares SO IT DOES NOT HIDE THE SQUARES NEXT TO IT
+    uint8_t rook = p.team ? 8 : 2;
+    int8_t dir = rook_x ? 1 : -1;
+    int8_t x;
+
+    if (p.first==0 || (p.y!=0 && p.y!=7) || !on_board(p.x+2*dir, p.y)) return 0;
+    if (squares[p.y*8+rook_x]!=rook || g->pieces[get_piece_index_by_type(rook, rook_x, p.y, *g)].first==0) return 0;
+
+    for (x=p.x+dir; x!=rook_x; x+=dir) {
+        if (squares[p.y*8+x]!=0) return 0;
+    }
+
+    return !is_attacked(squares, p.x+dir, p.y, !p.team) && !is_attacked(squares, p.x+2*dir, p.y, !p.team);
+}
+
+uint8_t detect_castling(uint8_t index, game_state g) {
+    // CASTLING DETECTION
+    piece p = g.pieces[index];
+
+    uint8_t turn_rook;
+    if (g.turn) {
+        turn_rook = 8;
+    } else {
+        turn_rook = 2;
+    }
+
+    uint8_t piece_type;
+    uint8_t left  = 1;
+    uint8_t right = 1;
+    
+    uint8_t j;
+    if (p.first==1 && (g.past_x==(p.x+2) || g.past_x==(p.x-2)) && (p.y==0 || p.y==7)) {
+        uint8_t left_piece_type  = get_piece_type_at(0, p.y, g);
+        uint8_t left_piece_first = get_piece_first_state_at(0, p.y, g);
+        uint8_t right_piece_type = get_piece_type_at(7, p.y, g);
+        uint8_t right_piece_first = get_piece_first_state_at(7, p.y, g);
+
+    
+        if (left_piece_type!=turn_rook || left_piece_first==0) {
+            left = 0;
+        }
+
+        if (right_piece_type!=turn_rook || right_piece_first==0) {
+            right = 0;
+        }
+        
+
+        if (left==0 && right==0) {
+            return 0;
+        }
+
+        // ONLY THE SIDE THE KING IS MOVING TOWARDS COUNTS
+        if (p.x>g.past_x) {
+            left = 0;
+        } else {
+            right = 0;
+        }
+
+        for (j=1; j<4; j++) {
+            piece_type = get_piece_type_at(g.past_x-j, p.y, g);
+            if (piece_type!=0) {
+                left = 0;
+            }
+        }
+
+        for (j=1; j<3; j++) {
+            piece_type = get_piece_type_at(g.past_x+j, p.y, g);
+            if (piece_type!=0) {
+                right = 0;
+            }
+        }
+
+        if ((left || right) && p.team==g.turn) {
+            // CANNOT CASTLE OUT OF OR THROUGH CHECK
+            g.pieces[index].x = g.past_x;
+            if (check_in_check(g)) return 0;
+
+            g.pieces[index].x = (p.x+g.past_x)/2;
+            if (check_in_check(g)) return 0;
+        }
+
+        if (left || right) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+
+uint8_t check_in_check(game_state g) {
+    uint8_t squares[64];
+    uint8_t king = find_king(&g, g.turn);
+    if (king==32) return 0;
+
+    fill_squares(&g, squares);
+    return is_attacked(squares, g.pieces[king].x, g.pieces[king].y, !g.turn);
+}
+
+uint8_t check_checkmate(game_state g) {
+    PROFILE_BEGIN(PROF_CHECK_CHECKMATE);
+    uint8_t result = 0;
+    if (check_in_check(g)) {
+        if (are_there_possible_moves(g)) {
+            result = 1; // CHECK
+        } else {
+            result = 2; // CHECKMATE
+        }
+    }
+    PROFILE_END(PROF_CHECK_CHECKMATE);
+
+    return result;
+}
+
+
+
+
+
+
+uint8_t will_take_piece(game_state g) {
+    // HANDLE IF NEEDS TO TAKE A PIECE
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        // HANDLE IF NEEDS TO TAKE PIECE
+        if (g.select.x==g.pieces[i].x && g.select.y==g.pieces[i].y && i!=g.selected_piece_index && g.pieces[i].taken==0) {
+            return 1;
+        }
+    }
+
+    // HANDLE EN PASSANT TAKING IF POSSIBLE
+    for (i=0; i<32; i++) {
+        if (g.can_en_passant && g.select.x==g.pieces[i].x && g.pieces[i].y==g.en_passant_y && g.pieces[i].x==g.en_passant_x && ((g.pieces[g.selected_piece_index].type==1 && g.select.y==g.en_passant_y-1) || (g.pieces[g.selected_piece_index].type==7 && g.select.y==g.en_passant_y+1)) && g.pieces[i].taken==0) {
+            return 1;
+        }
+    }
+
+
+    //for (i=0; i<32; i++) {
+    //    // HANDLE IF DOES NOT NEED TO TAKE PIECE BECAUSE PIECE IS ALREADY TAKEN
+    //    if (g.select.x==g.pieces[i].x && g.select.y==g.pieces[i].y && i!=g.selected_piece_index && g.pieces[i].taken==1) {
+    //        return 1;
+    //    }
+    //}
+
+    return 0;
+}
+
+game_state take_piece(game_state g) {
+    // HANDLE IF NEEDS TO TAKE A PIECE
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        // HANDLE IF NEEDS TO TAKE PIECE
+        if (g.select.x==g.pieces[i].x && g.select.y==g.pieces[i].y && i!=g.selected_piece_index && g.pieces[i].taken==0) {
+            g.board_past_x = g.select.x;
+            g.board_past_y = g.select.y;
+            g.has_drawn = 0;
+            g.pieces[i].taken = 1;
+            g.select.active = 0;
+            return g;
+        }
+    }
+
+    // HANDLE EN PASSANT TAKING IF POSSIBLE
+    for (i=0; i<32; i++) {
+        if (g.can_en_passant && g.select.x==g.pieces[i].x && g.pieces[i].y==g.en_passant_y && g.pieces[i].x==g.en_passant_x && ((g.pieces[g.selected_piece_index].type==1 && g.select.y==g.en_passant_y-1) || (g.pieces[g.selected_piece_index].type==7 && g.select.y==g.en_passant_y+1)) && g.pieces[i].taken==0) {
+            g.board_past_x = g.select.x;
+            g.board_past_y = g.select.y;
+            g.en_passant_occured = 1;
+            g.has_drawn = 0;
+            g.pieces[i].taken = 1;
+            g.select.active = 0;
+            return g;
+        }
+    }
+
+
+    //for (i=0; i<32; i++) {
+    //    // HANDLE IF DOES NOT NEED TO TAKE PIECE BECAUSE PIECE IS ALREADY TAKEN
+    //    if (g.select.x==g.pieces[i].x && g.select.y==g.pieces[i].y && i!=g.selected_piece_index && g.pieces[i].taken==1) {
+    //        g.board_past_x = g.select.x;
+    //        g.board_past_y = g.select.y;
+    //        g.has_drawn = 0;
+    //        g.select.active = 0;
+    //        return g;
+    //    }
+    //}
+
+    return g;
+}
+
+game_state move_and_possibly_take_piece(game_state g) {
+    if (will_take_piece(g)==0) {
+        // HANDLE CASTLING MOVEMENT IF OCCURING
+        uint8_t cst = detect_castling(g.selected_piece_index, g);
+        if ((g.pieces[g.selected_piece_index].type==6 || g.pieces[g.selected_piece_index].type==12) &&
+             cst) {
+            // CASTLING DETECTION
+            g.castling_occured = 1;
+
+            uint8_t index;
+            if (g.turn==0) {
+                if (g.select.x==6) {
+                    // RIGHT
+                    index = get_piece_index_by_type(2, 7, 7, g);
+                    g.pieces[index].x = 5;
+                    g.pieces[index].first = 0;
+
+                    g.board_past_x = g.select.x-1;
+                    g.board_past_y = g.select.y;
+                    g.has_drawn = 0;
+                    g.select.active = 0;
+                } else if (g.select.x==2) {
+                    // LEFT
+                    index = get_piece_index_by_type(2, 0, 7, g);
+                    g.pieces[index].x = 3;
+                    g.pieces[index].first = 0;
+
+                    g.board_past_x = g.select.x+1;
+                    g.board_past_y = g.select.y;
+                    g.has_drawn = 0;
+                    g.select.active = 0;                      
+                }
+            } else {
+                if (g.select.x==6) {
+                    // RIGHT
+                    index = get_piece_index_by_type(8, 7, 0, g);
+                    g.pieces[index].x = 5;
+                    g.pieces[index].first = 0;
+
+                    g.board_past_x = g.select.x-1;
+                    g.board_past_y = g.select.y;
+                    g.has_drawn = 0;
+                    g.select.active = 0;
+                } else if (g.select.x==2) {
+                    // LEFT
+                    index = get_piece_index_by_type(8, 0, 0, g);
+                    g.pieces[index].x = 3;
+                    g.pieces[index].first = 0;
+
+                    g.board_past_x = g.select.x+1;
+                    g.board_past_y = g.select.y;
+                    g.has_drawn = 0;
+                    g.select.active = 0;                       
+                }
+            }
+        } else {
+            // CATCH ALL FOR JUST GENERIC MOVEMENT
+            g.board_past_x = g.select.x;
+            g.board_past_y = g.select.y;
+            g.has_drawn = 0;
+            g.select.active = 0;
+        }
+    } else {
+        g = take_piece(g);
+    } 
+
+    // SET FLAG SHOWING PIECE MOVEMENT HAS OCCURED
+    g.pieces[g.selected_piece_index].first = 0;
+
+    // RESET EN PASSANT FLAG TO AVOID CONFLICTS
+    g.can_en_passant = 0;
+
+    // Set flags ready that en_passant can occur in the next move
+    if (g.pieces[g.selected_piece_index].type==1) {
+        if (g.pieces[g.selected_piece_index].y==(g.past_y-2)) {
+            g.can_en_passant = 1;
+            g.en_passant_x = g.pieces[g.selected_piece_index].x;
+            g.en_passant_y = g.pieces[g.selected_piece_index].y;
+        }
+    }
+
+    if (g.pieces[g.selected_piece_index].type==7) {
+        if (g.pieces[g.selected_piece_index].y==(g.past_y+2)) {
+            g.can_en_passant = 1;
+            g.en_passant_x = g.pieces[g.selected_piece_index].x;
+            g.en_passant_y = g.pieces[g.selected_piece_index].y;
+        }
+    }
+
+    return g;
+}
+
+
+
+
+
+
+uint8_t is_turn_valid(piece p, game_state g) {
+    // p HAS BEEN PUT DOWN ON ITS NEW SQUARE, g.past_x AND g.past_y ARE WHERE IT WAS PICKED UP FROM
+    uint8_t x = p.x;
+    uint8_t y = p.y;
+    p.x = g.past_x;
+    p.y = g.past_y;
+    g.pieces[g.selected_piece_index] = p;
+
+    move_set m_s = get_possible_moves_for_piece(p, g);
+    uint8_t i;
+    for (i=0; i<m_s.num_possible_moves; i++) {
+        if (m_s.possible_moves_x[i]==x && m_s.possible_moves_y[i]==y) return 1;
+    }
+
+    return 0;
+}
+
+
+
+
+
+
+uint8_t is_possible_move_for_piece(piece p, game_state g) {
+    // PUTTING THE PIECE BACK WHERE IT WAS DOES NOT COUNT, SO NO MOVES AND NOT IN CHECK IS STALEMATE
+    move_set m_s = get_possible_moves_for_piece(p, g);
+    uint8_t i;
+    for (i=0; i<m_s.num_possible_moves; i++) {
+        if (m_s.possible_moves_x[i]!=p.x || m_s.possible_moves_y[i]!=p.y) return 1;
+    }
+
+    return 0;
+}
+
+uint8_t are_there_possible_moves(game_state g) {
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g.pieces[i].team==g.turn && g.pieces[i].taken==0) {
+            if (is_possible_move_for_piece(g.pieces[i], g)) {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+move_set get_possible_moves_for_piece(piece p, game_state g) {
+    // LEGAL MOVES WITHOUT PLAYING EACH ONE AND LOOKING FOR CHECK: THE CHECKERS AND ANY PIN ON p ARE FOUND ONCE, FROM ITS KING,
+    // AND LIMIT WHERE p MAY GO. ONLY KING MOVES AND EN PASSANT ARE TESTED AGAINST THE BOARD THEY LEAVE.
+    // THE SQUARE p IS ON IS INCLUDED WHEN NOT IN CHECK, AS PUTTING THE PIECE BACK DOWN
+    PROFILE_BEGIN(PROF_GET_MOVES);
+    move_set m_s;
+
+    uint8_t squares[64];
+    uint8_t moves[8] = {0};     // ONE BIT PER x IN EACH RANK
+    uint8_t allowed[8];         // WHERE A PIECE OTHER THAN THE KING MAY GO
+    uint8_t block[8] = {0};
+    uint8_t enemy = !p.team;
+    uint8_t kind = KIND(p.type);
+    uint8_t king = find_king(&g, p.team);
+    uint8_t checks = 0;
+    uint8_t i, type;
+    int8_t x, y, kx = 0, ky = 0;
+
+    fill_squares(&g, squares);
+
+    if (king<32) {
+        kx = g.pieces[king].x;
+        ky = g.pieces[king].y;
+
+        // CHECKERS: ANOTHER PIECE HAS TO TAKE THE CHECKER OR STAND BETWEEN IT AND THE KING
+        for (i=0; i<8; i++) {
+            x = kx;
+            y = ky;
+            type = walk(squares, &x, &y, i);
+            if (type && TEAM(type)==enemy && slides_along(type, i)) {
+                mark_ray(block, kx, ky, x, y, i);
+                checks++;
+            }
+        }
+
+        for (i=0; i<8; i++) {
+            x = kx+knight_dx[i];
+            y = ky+knight_dy[i];
+            if (on_board(x, y) && squares[y*8+x]==(enemy ? 9 : 3)) {
+                block[y] |= 1<<x;
+                checks++;
+            }
+        }
+
+        y = enemy ? ky-1 : ky+1;
+        for (x=kx-1; x<=kx+1; x+=2) {
+            if (on_board(x, y) && squares[y*8+x]==(enemy ? 7 : 1)) {
+                block[y] |= 1<<x;
+                checks++;
+            }
+        }
+    }
+
+    for (i=0; i<8; i++) {
+        if (checks==0) allowed[i] = 0xFF;
+        else if (checks==1) allowed[i] = block[i];
+        else allowed[i] = 0;    // DOUBLE CHECK: ONLY THE KING CAN MOVE
+    }
+
+    if (king<32 && kind!=5 && (p.x==kx || p.y==ky || p.x-kx==p.y-ky || p.x-kx==ky-p.y)) {
+        // PINNED IF p IS THE FIRST PIECE OUT FROM ITS KING AND AN ENEMY SLIDER ON THE SAME LINE IS NEXT: IT CAN ONLY MOVE ALONG THAT LINE
+        uint8_t pin[8] = {0};
+        int8_t dx = p.x>kx ? 1 : (p.x<kx ? -1 : 0);
+        int8_t dy = p.y>ky ? 1 : (p.y<ky ? -1 : 0);
+        for (i=0; ray_dx[i]!=dx || ray_dy[i]!=dy; i++);
+
+        x = kx;
+        y = ky;
+        walk(squares, &x, &y, i);
+        if (x==p.x && y==p.y) {
+            type = walk(squares, &x, &y, i);
+            if (type && TEAM(type)==enemy && slides_along(type, i)) {
+                mark_ray(pin, kx, ky, x, y, i);
+                for (i=0; i<8; i++) allowed[i] &= pin[i];
+            }
+        }
+    }
+
+    if (kind==0) {
+        // PAWN: ONE FORWARDS ONTO AN EMPTY SQUARE, TWO ON ITS FIRST MOVE, DIAGONALLY ONLY TO TAKE
+        int8_t forwards = p.team ? 1 : -1;
+        y = p.y+forwards;
+        if (on_board(p.x, y)) {
+            if (squares[y*8+p.x]==0) {
+                moves[y] |= 1<<p.x;
+                if (p.first && on_board(p.x, y+forwards) && squares[(y+forwards)*8+p.x]==0) moves[y+forwards] |= 1<<p.x;
+            }
+
+            for (x=p.x-1; x<=p.x+1; x+=2) {
+                if (on_board(x, y) && squares[y*8+x] && TEAM(squares[y*8+x])==enemy) moves[y] |= 1<<x;
+            }
+        }
+
+        for (i=0; i<8; i++) moves[i] &= allowed[i];
+
+        if (g.can_en_passant && p.y==g.en_passant_y && (g.en_passant_x==p.x-1 || g.en_passant_x==p.x+1)) {
+            // TWO PAWNS LEAVE THE SAME RANK, WHICH A PIN ON EITHER ONE ALONE DOES NOT SHOW, SO TRY IT ON THE BOARD
+            uint8_t taken = squares[p.y*8+g.en_passant_x];
+            squares[p.y*8+p.x] = 0;
+            squares[p.y*8+g.en_passant_x] = 0;
+            squares[y*8+g.en_passant_x] = p.type;
+            if (king==32 || !is_attacked(squares, kx, ky, enemy)) moves[y] |= 1<<g.en_passant_x;
+            squares[y*8+g.en_passant_x] = 0;
+            squares[p.y*8+g.en_passant_x] = taken;
+            squares[p.y*8+p.x] = p.type;
+        }
+    } else if (kind==2) {
+        for (i=0; i<8; i++) {
+            x = p.x+knight_dx[i];
+            y = p.y+knight_dy[i];
+            if (on_board(x, y) && (squares[y*8+x]==0 || TEAM(squares[y*8+x])==enemy)) moves[y] |= 1<<x;
+        }
+
+        for (i=0; i<8; i++) moves[i] &= allowed[i];
+    } else if (kind==5) {
+        // KING: TAKEN OFF THE BOARD FIRST, OR IT WOULD SHIELD THE SQUARE BEHIND IT FROM A SLIDER CHECKING IT
+        squares[p.y*8+p.x] = 0;
+        for (i=0; i<8; i++) {
+            x = p.x+ray_dx[i];
+            y = p.y+ray_dy[i];
+            if (on_board(x, y) && (squares[y*8+x]==0 || TEAM(squares[y*8+x])==enemy) && !is_attacked(squares, x, y, enemy)) moves[y] |= 1<<x;
+        }
+
+        if (checks==0) {
+            if (can_castle_with(0, p, &g, squares)) moves[p.y] |= 1<<(p.x-2);
+            if (can_castle_with(7, p, &g, squares)) moves[p.y] |= 1<<(p.x+2);
+        }
+    } else {
+        // ROOK, BISHOP, QUEEN: ALONG EACH OF ITS LINES UP TO AND INCLUDING THE FIRST ENEMY PIECE
+        for (i=0; i<8; i++) {
+            if (!slides_along(p.type, i)) continue;
+            x = p.x;
+            y = p.y;
+            type = walk(squares, &x, &y, i);
+            if (type && TEAM(type)!=enemy) {
+                x -= ray_dx[i];
+                y -= ray_dy[i];
+            }
+            if (x!=p.x || y!=p.y) mark_ray(moves, p.x, p.y, x, y, i);
+        }
+
+        for (i=0; i<8; i++) moves[i] &= allowed[i];
+    }
+
+    if (checks==0) moves[p.y] |= 1<<p.x;
+
+    uint8_t counter = 0;
+    for (y=0; y<8; y++) {
+        for (x=0; x<8; x++) {
+            if (moves[y] & (1<<x)) {
+                m_s.possible_moves_x[counter] = x;
+                m_s.possible_moves_y[counter] = y;
+                counter++;
+            }
+        }
+    }
+
+    m_s.num_possible_moves = counter;
+    PROFILE_END(PROF_GET_MOVES);
+
+    return m_s;
+}
+
+
+
+
+
+
+
+game_state count_move(game_state g, uint8_t irreversible) {
+    // CALLED BEFORE THE TURN CHANGES. IRREVERSIBLE: A PAWN MOVE OR A CAPTURE
+    if (irreversible) g.halfmove_clock = 0;
+    else if (g.halfmove_clock<255) g.halfmove_clock++;
+
+    if (g.turn) g.fullmove_number++;
+
+    return g;
+}
+
+game_state make_move(game_state g, uint8_t index, uint8_t x, uint8_t y) {
+    // SAME STEPS AS A PLAYER: PICK UP, DRAG TO (x, y), PUT DOWN, OTHER SIDE TO MOVE
+    uint8_t pawn = g.pieces[index].type==1 || g.pieces[index].type==7;
+    g.selected_piece_index = index;
+    g.past_x = g.pieces[index].x;
+    g.past_y = g.pieces[index].y;
+    g.pieces[index].x = x;
+    g.pieces[index].y = y;
+    g.select.x = x;
+    g.select.y = y;
+
+    uint8_t irreversible = pawn || will_take_piece(g);
+    g = move_and_possibly_take_piece(g);
+    g = count_move(g, irreversible);
+    g.turn = !g.turn;
+
+    return g;
+}
+
+uint8_t get_piece_index_at(uint8_t x, uint8_t y, game_state g) {
+    // UNTAKEN PIECE ON (x, y), 32 IF THE SQUARE IS EMPTY
+    uint8_t i;
+    for (i=0; i<32; i++) {
+        if (g.pieces[i].x==x && g.pieces[i].y==y && g.pieces[i].taken==0) return i;
+    }
+
+    return 32;
+}
+
+game_state promote_piece(game_state g, uint8_t index, uint8_t promotion) {
+    // INDEXED BY PROMOTE_KNIGHT..PROMOTE_QUEEN
+    static const uint8_t types[4] = {3, 4, 2, 5};
+    g.pieces[index].type = types[promotion] + (g.pieces[index].team ? 6 : 0);
+
+    return g;
+}
+
+uint8_t move_flags(game_state g, uint8_t type, uint8_t from, uint8_t to) {
+    // WHAT HISTORY, UNDO AND SAN NEED TO KNOW ABOUT A MOVE, FROM THE POSITION BEFORE IT IS MADE
+    uint8_t pawn = type==1 || type==7;
+
+    if (pawn && (to/8==0 || to/8==7)) return MOVE_PROMOTION;
+    if (pawn && g.can_en_passant && from/8==g.en_passant_y && to%8==g.en_passant_x && from%8!=to%8) return MOVE_EN_PASSANT;
+    if ((type==6 || type==12) && calc_x_difference_from_past(from%8, to%8)==2) return MOVE_CASTLE;
+
+    return MOVE_NORMAL;
+}
+
+game_state play_move(game_state g, packed_move m) {
+    uint8_t from = MOVE_FROM(m);
+    uint8_t to = MOVE_TO(m);
+    uint8_t index = get_piece_index_at(from%8, from/8, g);
+
+    g = make_move(g, index, to%8, to/8);
+    if (MOVE_FLAGS(m)==MOVE_PROMOTION) g = promote_piece(g, index, MOVE_PROMOTES_TO(m));
+
+    return g;
+}
+
+game_state unmake_move(game_state g, packed_move m, undo_record u) {
+    // PUT THE MOVER BACK AND RESTORE ONLY WHAT THE MOVE CHANGED
+    uint8_t from = MOVE_FROM(m);
+    uint8_t to = MOVE_TO(m);
+
+    uint8_t index = get_piece_index_at(to%8, to/8, g);
+    g.pieces[index].x = from%8;
+    g.pieces[index].y = from/8;
+    g.pieces[index].first = u.first;
+
+    if (MOVE_FLAGS(m)==MOVE_PROMOTION) g.pieces[index].type = g.pieces[index].team ? 7 : 1;
+
+    if (MOVE_FLAGS(m)==MOVE_CASTLE) {
+        uint8_t rook = get_piece_index_at(to%8==6 ? 5 : 3, to/8, g);
+        g.pieces[rook].x = to%8==6 ? 7 : 0;
+        g.pieces[rook].first = 1;
+    }
+
+    if (u.captured!=NO_CAPTURE) g.pieces[u.captured].taken = 0;
+
+    g.can_en_passant = u.en_passant!=NO_EN_PASSANT;
+    g.en_passant_x = u.en_passant%8;
+    g.en_passant_y = u.en_passant/8;
+
+    g.halfmove_clock = u.halfmove_clock;
+    g.turn = !g.turn;
+    if (g.turn) g.fullmove_number--;
+
+    return g;
+}
+
+uint8_t is_legal_move(game_state g, packed_move m) {
+    // A MOVE FROM OUTSIDE THE GAME (SAVED, TYPED): CHECK IT AGAINST THE MOVER'S POSSIBLE MOVES
+    uint8_t from = MOVE_FROM(m);
+    uint8_t to = MOVE_TO(m);
+    uint8_t index = get_piece_index_at(from%8, from/8, g);
+
+    if (from==to || index==32 || g.pieces[index].team!=g.turn) return 0;
+
+    move_set m_s = get_possible_moves_for_piece(g.pieces[index], g);
+    uint8_t i;
+    for (i=0; i<m_s.num_possible_moves; i++) {
+        if (m_s.possible_moves_x[i]==to%8 && m_s.possible_moves_y[i]==to/8) return 1;
+    }
+
+    return 0;
+}
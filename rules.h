@@ -0,0 +1,50 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#ifndef RULES_H
+#define RULES_H
+
+#include "chess.h"
+#include "history.h"
+
+// First move is always white
+// Team: 0 (White), 1 (BLACK)
+// Type (WHITE): 1 (Pawn), 2 (Rook), 3 (Knight), 4 (Bishop), 5 (Queen), 6 (King)
+// Type (BLACK): 7 (Pawn), 8 (Rook), 9 (Knight),10 (Bishop),11 (Queen),12 (King)
+
+uint8_t get_piece_type_at(uint8_t, uint8_t, game_state);
+uint8_t get_piece_first_state_at(uint8_t, uint8_t, game_state);
+uint8_t get_piece_index_by_type(uint8_t, uint8_t, uint8_t, game_state);
+int8_t get_piece_index_in_game_state(piece, game_state);
+
+uint8_t calc_x_difference_from_past(uint8_t, uint8_t);
+uint8_t calc_y_difference_from_past(uint8_t, uint8_t);
+
+uint8_t detect_castling(uint8_t, game_state);
+
+uint8_t check_in_check(game_state);
+uint8_t check_checkmate(game_state);
+
+uint8_t will_take_piece(game_state);
+game_state take_piece(game_state);
+game_state move_and_possibly_take_piece(game_state);
+
+uint8_t is_turn_valid(piece p, game_state);
+
+uint8_t is_possible_move_for_piece(piece, game_state);
+uint8_t are_there_possible_moves(game_state);
+move_set get_possible_moves_for_piece(piece, game_state);
+
+game_state count_move(game_state, uint8_t);
+game_state make_move(game_state, uint8_t, uint8_t, uint8_t);
+
+uint8_t get_piece_index_at(uint8_t, uint8_t, game_state);
+game_state promote_piece(game_state, uint8_t, uint8_t);
+uint8_t move_flags(game_state, uint8_t, uint8_t, uint8_t);
+game_state play_move(game_state, packed_move);
+game_state unmake_move(game_state, packed_move, undo_record);
+uint8_t is_legal_move(game_state, packed_move);
+
+#endif
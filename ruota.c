@@ -5,48 +5,69 @@
     Slightly adapted by Klaus-Peter Zauner for FortunaOS, March 2015
 */
 
-#include <avr/interrupt.h>
-
+#include "hal.h"
 #include "ruota.h"
+#include "profile.h"
 volatile uint8_t switch_state;   /* debounced and inverted key state:
                                  bit = 1: key pressed */
 volatile uint8_t switch_press;   /* key press detect */
 volatile uint8_t switch_rpt;     /* key long press and repeat */
 
-void init_buttons() {
+/* Single-producer (scan_switches) / single-consumer (main loop) ring.
+   Each index is a byte written by one side only, so no locking is needed. */
+static volatile switch_event events[EVENT_QUEUE_SIZE];
+static volatile uint8_t event_head;     /* written by scan_switches only */
+static volatile uint8_t event_tail;     /* written by get_switch_event only */
+static volatile uint8_t events_dropped;
+static volatile uint16_t switch_ticks;
+static uint16_t scan_time;              /* Timer 3 ticks at this scan */
 
-    DDRE &= ~_BV(SWC);   /* Central button */
-	PORTE |= _BV(SWC);
-	
-	DDRC &= ~COMPASS_SWITCHES;  /* configure compass buttons for input */
-	PORTC |= COMPASS_SWITCHES;  /* and turn on pull up resistors */
+static void push_events( uint8_t type, uint8_t switches ) {
+  uint8_t bit, next;
+  for( bit = 1; bit; bit <<= 1 ) {
+    if( !(switches & bit) )
+      continue;
+    next = (event_head + 1) & (EVENT_QUEUE_SIZE - 1);
+    if( next == event_tail ) {           /* full: keep the older events */
+      events_dropped++;
+      continue;
+    }
+    events[event_head].type = type;
+    events[event_head].switches = bit;
+    events[event_head].time = scan_time;
+    event_head = next;                   /* publish after the payload */
+  }
+}
 
-    EICRB |= _BV(ISC40) | _BV(ISC50) | _BV(ISC71);
+void init_buttons() {
+    hal_switches_init();
 }
 
 void scan_switches() {
   static uint8_t ct0, ct1, rpt;
+  static uint8_t long_sent;              /* switches whose long press is out */
   uint8_t i;
  
   cli();
-  /* 
-     Overlay port E for central button of switch wheel and Port B
-     for SD card detection switch:
-  */ 
-  i = switch_state ^ ~( (PINC|_BV(SWC)|_BV(OS_CD))	\
-                   & (PINE|~_BV(SWC)) \
-                   & (PINB|~_BV(OS_CD)));  /* switch has changed */
+  switch_ticks++;
+  scan_time = profile_now();
+  i = switch_state ^ ~hal_switch_pins();   /* switch has changed */
   ct0 = ~( ct0 & i );                      /* reset or count ct0 */
   ct1 = ct0 ^ (ct1 & i);                   /* reset or count ct1 */
   i &= ct0 & ct1;                          /* count until roll over ? */
   switch_state ^= i;                       /* then toggle debounced state */
   switch_press |= switch_state & i;        /* 0->1: key press detect */
+  push_events( SWITCH_PRESS, switch_state & i );
+  long_sent &= switch_state;               /* released keys may go long again */
  
-  if( (switch_state & ALL_SWITCHES) == 0 )     /* check repeat function */
+  if( (switch_state & HELD_SWITCHES) == 0 )    /* check repeat function */
      rpt = REPEAT_START;                 /* start delay */
   if( --rpt == 0 ){
     rpt = REPEAT_NEXT;                   /* repeat delay */
-    switch_rpt |= switch_state & ALL_SWITCHES;
+    switch_rpt |= switch_state & HELD_SWITCHES;
+    push_events( SWITCH_REPEAT, switch_state & HELD_SWITCHES & long_sent );
+    push_events( SWITCH_LONG, switch_state & HELD_SWITCHES & ~long_sent );
+    long_sent |= switch_state & HELD_SWITCHES;
   }
   sei();
 }
@@ -79,4 +100,31 @@ uint8_t get_switch_short( uint8_t switch_mask ) {
 
 uint8_t get_switch_long( uint8_t switch_mask ) {
   return get_switch_press( get_switch_rpt( switch_mask ));
-}
\ No newline at end of file
+}
+
+uint8_t get_switch_event( switch_event *e ) {
+  uint8_t t = event_tail;
+  if( t == event_head )
+    return 0;
+  e->type = events[t].type;
+  e->switches = events[t].switches;
+  e->time = events[t].time;
+  event_tail = (t + 1) & (EVENT_QUEUE_SIZE - 1);   /* release the slot last */
+  return 1;
+}
+
+uint16_t get_switch_ticks( void ) {
+  uint16_t t;
+  cli();                         /* 16-bit read of an ISR counter */
+  t = switch_ticks;
+  sei();
+  return t;
+}
+
+uint8_t switch_events_pending( void ) {
+  return event_tail != event_head;
+}
+
+uint8_t get_switch_events_dropped( void ) {
+  return events_dropped;
+}
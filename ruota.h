@@ -17,6 +17,20 @@
 
 #define COMPASS_SWITCHES (_BV(SWW)|_BV(SWS)|_BV(SWE)|_BV(SWN))
 #define ALL_SWITCHES (_BV(SWC) | COMPASS_SWITCHES | _BV(OS_CD))
+#define HELD_SWITCHES (_BV(SWC) | COMPASS_SWITCHES)   /* repeat and go long, the card detect does not */
+
+#define EVENT_QUEUE_SIZE    16      /* power of two */
+
+/* switch_event.type */
+#define SWITCH_PRESS    1       /* debounced 0->1 */
+#define SWITCH_LONG     2       /* held for REPEAT_START, sent once per hold */
+#define SWITCH_REPEAT   3       /* every REPEAT_NEXT after that */
+
+typedef struct {
+    uint8_t type;
+    uint8_t switches;           /* single switch bit */
+    uint16_t time;              /* profile_now() when it was seen (32us ticks) */
+} switch_event;
 
 void init_buttons( void );
 void scan_switches( void );
@@ -25,5 +39,9 @@ uint8_t get_switch_rpt( uint8_t switch_mask );
 uint8_t get_switch_state( uint8_t switch_mask );
 uint8_t get_switch_short( uint8_t switch_mask );
 uint8_t get_switch_long( uint8_t switch_mask );
+uint8_t get_switch_event( switch_event *e );
+uint16_t get_switch_ticks( void );
+uint8_t switch_events_pending( void );
+uint8_t get_switch_events_dropped( void );
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,338 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include <string.h>
+
+#include "hal.h"
+#include "save.h"
+
+#define QUEUE_SLOT(n)   ((n) & (SAVE_QUEUE - 1))
+
+/* Indexed by (type-1)%6 */
+static const char letters[6] = {'P', 'R', 'N', 'B', 'Q', 'K'};
+
+
+
+void save_init(save_state *s)
+{
+    s->slot = SAVE_SLOTS - 1;
+    s->sequence = 0;
+    s->base = 0;
+    s->lost = 0;
+    s->header_written = 0;
+    s->head = s->tail = 0;
+}
+
+static uint16_t crc16_update(uint16_t crc, uint8_t data)
+{
+    /* CCITT, polynomial 0x1021 */
+    uint8_t i;
+    crc ^= (uint16_t)data << 8;
+    for (i = 0; i < 8; i++)
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
+
+static uint16_t crc16(uint16_t crc, const uint8_t *data, uint8_t length)
+{
+    while (length--)
+        crc = crc16_update(crc, *data++);
+    return crc;
+}
+
+/* Records carry the save's slot, sequence and their own index in the CRC,
+ * so a record left over from an older game or a longer line never checks out. */
+static uint16_t record_crc(save_state *s, uint16_t index, packed_move m)
+{
+    uint8_t bytes[7] = {s->slot, s->sequence, s->sequence >> 8, index, index >> 8, m, m >> 8};
+    return crc16(0xFFFF, bytes, sizeof(bytes));
+}
+
+static uint16_t slot_address(uint8_t slot)
+{
+    return (uint16_t)slot * SAVE_SLOT_SIZE;
+}
+
+static uint16_t record_address(save_state *s, uint16_t index)
+{
+    return slot_address(s->slot) + sizeof(save_header) + index * SAVE_RECORD_SIZE;
+}
+
+/* Never waits: if the queue is full the byte is dropped and the save is
+ * marked lost, so save_move asks for a new one */
+static uint8_t queue_byte(save_state *s, uint16_t address, uint8_t data)
+{
+    if (QUEUE_SLOT(s->tail + 1) == QUEUE_SLOT(s->head)) {
+        s->lost = 1;
+        return 0;
+    }
+    s->queue_address[QUEUE_SLOT(s->tail)] = address;
+    s->queue_data[QUEUE_SLOT(s->tail)] = data;
+    s->tail = QUEUE_SLOT(s->tail + 1);
+    return 1;
+}
+
+static void queue_record(save_state *s, uint16_t index, packed_move m, uint16_t crc)
+{
+    uint16_t address = record_address(s, index);
+    queue_byte(s, address, m);
+    queue_byte(s, address + 1, m >> 8);
+    queue_byte(s, address + 2, crc);
+    queue_byte(s, address + 3, crc >> 8);
+    hal_eeprom_ready_interrupt(1);
+}
+
+/* Next queued byte; on the board called from the EEPROM ready interrupt.
+ * A header place writes whichever header is newest when it comes up, so one
+ * begun while an older one was waiting is written whole by its own place. */
+void save_ready(save_state *s)
+{
+    if (s->head == s->tail) {
+        hal_eeprom_ready_interrupt(0);
+        return;
+    }
+    if (s->queue_address[s->head] == SAVE_QUEUE_HEADER) {
+        hal_eeprom_write(slot_address(s->header_slot) + s->header_written,
+                         ((uint8_t *)&s->header)[s->header_written]);
+        if (++s->header_written < sizeof(save_header))
+            return;
+        s->header_written = 0;
+    } else {
+        hal_eeprom_write(s->queue_address[s->head], s->queue_data[s->head]);
+    }
+    s->head = QUEUE_SLOT(s->head + 1);
+}
+
+void save_flush(save_state *s)
+{
+    while (s->head != s->tail) {
+        hal_eeprom_wait();
+        save_ready(s);
+    }
+}
+
+
+
+static void pack_square(save_header *h, uint8_t square, uint8_t type)
+{
+    if (square & 1)
+        h->squares[square / 2] |= type << 4;
+    else
+        h->squares[square / 2] |= type;
+}
+
+static uint8_t unpack_square(save_header *h, uint8_t square)
+{
+    return square & 1 ? h->squares[square / 2] >> 4 : h->squares[square / 2] & 0x0F;
+}
+
+static uint16_t read_number(const char **fen)
+{
+    uint16_t n = 0;
+    while (**fen >= '0' && **fen <= '9')
+        n = n * 10 + (*(*fen)++ - '0');
+    return n;
+}
+
+static char *write_number(char *s, uint16_t n)
+{
+    char digits[5];
+    uint8_t i = 0;
+    do {
+        digits[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    while (i)
+        *s++ = digits[--i];
+    return s;
+}
+
+/* The caller's FEN comes from fen_write, so it is well formed */
+static void header_from_fen(save_header *h, const char *fen)
+{
+    uint8_t square = 0, i;
+
+    memset(h, 0, sizeof(*h));
+    h->magic = SAVE_MAGIC;
+    h->en_passant = SAVE_NO_SQUARE;
+
+    for (; *fen != ' '; fen++) {
+        if (*fen >= '1' && *fen <= '8') {
+            square += *fen - '0';
+        } else if (*fen != '/') {
+            uint8_t black = *fen >= 'a';
+            char upper = black ? *fen - ('a' - 'A') : *fen;
+            for (i = 0; i < 6; i++)
+                if (letters[i] == upper)
+                    pack_square(h, square, i + 1 + black * 6);
+            square++;
+        }
+    }
+
+    if (*++fen == 'b')
+        h->flags |= SAVE_BLACK_TO_MOVE;
+    fen += 2;
+    for (; *fen != ' '; fen++) {
+        if (*fen == 'K') h->flags |= 0x02;
+        if (*fen == 'Q') h->flags |= 0x04;
+        if (*fen == 'k') h->flags |= 0x08;
+        if (*fen == 'q') h->flags |= 0x10;
+    }
+    fen++;
+    if (*fen != '-') {
+        h->en_passant = ('8' - fen[1]) * 8 + fen[0] - 'a';
+        fen++;
+    }
+    fen += 2;
+    h->halfmove_clock = read_number(&fen);
+    fen++;
+    h->fullmove_number = read_number(&fen);
+}
+
+static void fen_from_header(save_header *h, char *fen)
+{
+    static const char castling[4] = {'K', 'Q', 'k', 'q'};
+    uint8_t x, y, empty, i;
+
+    for (y = 0; y < 8; y++) {
+        empty = 0;
+        for (x = 0; x < 8; x++) {
+            uint8_t type = unpack_square(h, y*8 + x);
+            if (type) {
+                if (empty) *fen++ = '0' + empty;
+                empty = 0;
+                *fen++ = letters[(type - 1) % 6] + (type > 6 ? 'a' - 'A' : 0);
+            } else {
+                empty++;
+            }
+        }
+        if (empty) *fen++ = '0' + empty;
+        if (y < 7) *fen++ = '/';
+    }
+
+    *fen++ = ' ';
+    *fen++ = h->flags & SAVE_BLACK_TO_MOVE ? 'b' : 'w';
+    *fen++ = ' ';
+    if (!(h->flags & SAVE_CASTLING))
+        *fen++ = '-';
+    for (i = 0; i < 4; i++)
+        if (h->flags & (0x02 << i))
+            *fen++ = castling[i];
+    *fen++ = ' ';
+    if (h->en_passant == SAVE_NO_SQUARE) {
+        *fen++ = '-';
+    } else {
+        *fen++ = 'a' + h->en_passant % 8;
+        *fen++ = '8' - h->en_passant / 8;
+    }
+    *fen++ = ' ';
+    fen = write_number(fen, h->halfmove_clock);
+    *fen++ = ' ';
+    fen = write_number(fen, h->fullmove_number);
+    *fen = '\0';
+}
+
+static uint8_t read_header(uint8_t slot, save_header *h)
+{
+    uint8_t *bytes = (uint8_t *)h;
+    uint8_t i;
+    for (i = 0; i < sizeof(*h); i++)
+        bytes[i] = hal_eeprom_read(slot_address(slot) + i);
+    return h->magic == SAVE_MAGIC && h->crc == crc16(0xFFFF, bytes, sizeof(*h) - 2);
+}
+
+
+
+/* Newest valid save: its starting position goes to fen (FEN_MAX bytes) and
+ * s is set up to carry on writing to it. Returns 0 if there is none. */
+uint8_t save_find(save_state *s, char *fen)
+{
+    save_header h;
+    uint8_t slot, found = 0;
+
+    for (slot = 0; slot < SAVE_SLOTS; slot++) {
+        if (!read_header(slot, &h))
+            continue;
+        if (found && (int16_t)(h.sequence - s->sequence) <= 0)
+            continue;
+        found = 1;
+        s->slot = slot;
+        s->sequence = h.sequence;
+    }
+    if (!found)
+        return 0;
+
+    read_header(s->slot, &h);
+    fen_from_header(&h, fen);
+    s->base = 0;
+    return 1;
+}
+
+/* Record index of the save found, 0 once past the last one written */
+uint8_t save_record(save_state *s, uint16_t index, packed_move *m)
+{
+    uint16_t address = record_address(s, index);
+    uint16_t crc;
+
+    if (index >= SAVE_RECORDS)
+        return 0;
+    *m = hal_eeprom_read(address) | (uint16_t)hal_eeprom_read(address + 1) << 8;
+    crc = hal_eeprom_read(address + 2) | (uint16_t)hal_eeprom_read(address + 3) << 8;
+    return crc == record_crc(s, index, *m);
+}
+
+/* A new save in the next slot, starting from fen at history ply */
+void save_begin(save_state *s, const char *fen, uint16_t ply)
+{
+    save_header *h = &s->header;
+
+    s->slot = (s->slot + 1) % SAVE_SLOTS;
+    s->sequence++;
+    s->base = ply;
+    header_from_fen(h, fen);
+    h->sequence = s->sequence;
+    h->crc = crc16(0xFFFF, (uint8_t *)h, sizeof(*h) - 2);
+    s->header_slot = s->slot;
+
+    s->lost = !queue_byte(s, SAVE_QUEUE_HEADER, 0);
+    hal_eeprom_ready_interrupt(1);
+}
+
+/* The move that took the game to ply+1. Returns 0 if the slot is full and
+ * a new save should be started from the position reached. */
+uint8_t save_move(save_state *s, uint16_t ply, packed_move m)
+{
+    uint16_t index = ply - s->base;
+
+    if (ply < s->base)
+        return 1;   /* before this save began */
+    if (index >= SAVE_RECORDS || s->lost)
+        return 0;
+
+    queue_record(s, index, m, record_crc(s, index, m));
+    return 1;
+}
+
+/* Taken back to ply: the record that led on from there no longer counts */
+void save_truncate(save_state *s, uint16_t ply)
+{
+    uint16_t index = ply - s->base;
+
+    if (ply < s->base || index >= SAVE_RECORDS)
+        return;
+
+    queue_record(s, index, 0xFFFF, ~record_crc(s, index, 0xFFFF));
+}
+
+/* The game has ended: spoil every header, so the next power-up starts afresh
+ * rather than resuming this game or an older one */
+void save_finish(save_state *s)
+{
+    uint8_t slot;
+
+    for (slot = 0; slot < SAVE_SLOTS; slot++)
+        queue_byte(s, slot_address(slot), (uint8_t)~SAVE_MAGIC);
+    hal_eeprom_ready_interrupt(1);
+}
@@ -0,0 +1,72 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Game saved to EEPROM as it is played: a position header, then one record
+ *  per ply. Each new save goes to the next slot, so writes are spread over
+ *  the whole EEPROM. Bytes are queued and written from the EEPROM ready
+ *  interrupt, so a move never waits for the 3.4ms byte write. A header takes
+ *  one place in the queue and is written from a copy a byte at a time, and
+ *  nothing waits for room: if the queue is full the save is started again
+ *  at the next move.
+ */
+
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <stdint.h>
+
+#include "history.h"
+
+#define SAVE_EEPROM_SIZE    4096
+#define SAVE_SLOTS          4
+#define SAVE_SLOT_SIZE      (SAVE_EEPROM_SIZE / SAVE_SLOTS)
+#define SAVE_MAGIC          0x4C
+#define SAVE_RECORD_SIZE    4       /* packed move, CRC-16 */
+#define SAVE_RECORDS        ((SAVE_SLOT_SIZE - sizeof(save_header)) / SAVE_RECORD_SIZE)
+#define SAVE_QUEUE          64      /* bytes waiting to be written, power of two */
+#define SAVE_QUEUE_HEADER   0xFFFF  /* queued address standing for the whole header */
+
+#define SAVE_BLACK_TO_MOVE  0x01
+#define SAVE_CASTLING       0x1E    /* KQkq in bits 1-4 */
+#define SAVE_NO_SQUARE      0xFF
+
+/* No padding on either target: 42 bytes */
+typedef struct {
+    uint8_t magic;
+    uint8_t flags;
+    uint8_t en_passant;         /* target square y*8+x, SAVE_NO_SQUARE if none */
+    uint8_t halfmove_clock;
+    uint16_t sequence;          /* newest valid header wins */
+    uint16_t fullmove_number;
+    uint8_t squares[32];        /* piece type 0-12, two squares per byte, a8 first */
+    uint16_t crc;               /* CRC-16 of the bytes above */
+} save_header;
+
+typedef struct {
+    uint8_t slot;
+    uint16_t sequence;
+    uint16_t base;              /* history ply of record 0 */
+    uint8_t lost;               /* a byte found the queue full */
+    save_header header;         /* newest header, written when its place comes up */
+    uint8_t header_slot;
+    uint8_t header_written;     /* bytes of it written so far */
+    uint16_t queue_address[SAVE_QUEUE];
+    uint8_t queue_data[SAVE_QUEUE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+} save_state;
+
+void save_init(save_state *s);
+uint8_t save_find(save_state *s, char *fen);
+uint8_t save_record(save_state *s, uint16_t index, packed_move *m);
+
+void save_begin(save_state *s, const char *fen, uint16_t ply);
+uint8_t save_move(save_state *s, uint16_t ply, packed_move m);
+void save_truncate(save_state *s, uint16_t ply);
+void save_finish(save_state *s);
+
+void save_ready(save_state *s);
+void save_flush(save_state *s);
+
+#endif
@@ -0,0 +1,26 @@
+#!/bin/sh
+# Runs chess_host over each script from a blank EEPROM and compares the
+# final panel checksum with the one on the script's first line:
+#
+#     # checksum 6236c689
+#
+# usage: scripts/check.sh ./chess_host scripts/*.txt
+
+host=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+shift
+status=0
+dir=$(mktemp -d)
+for script in "$@"; do
+    path=$(cd "$(dirname "$script")" && pwd)/$(basename "$script")
+    want=$(sed -n '1s/^# checksum //p' "$path")
+    rm -f "$dir/eeprom.bin"
+    got=$(cd "$dir" && CHESS_SCRIPT="$path" "$host" | sed -n 's/.*checksum \([0-9a-f]*\)$/\1/p')
+    if [ "$got" = "$want" ]; then
+        echo "$script: ok"
+    else
+        echo "$script: checksum $got, expected $want"
+        status=1
+    fi
+done
+rm -rf "$dir"
+exit $status
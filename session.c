@@ -0,0 +1,143 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include <string.h>
+
+#include "session.h"
+#include "rules.h"
+#include "fen.h"
+
+void session_pool_init(session_pool *p, session_slot *slots, uint16_t capacity)
+{
+    uint16_t i;
+    for (i = 0; i + 1 < capacity; i++)
+        slots[i].next = &slots[i + 1];
+    if (capacity)
+        slots[capacity - 1].next = 0;
+    p->free = capacity ? slots : 0;
+    p->used = 0;
+    p->capacity = capacity;
+}
+
+/* 0 when the pool is full or the FEN does not read */
+session *session_open(session_pool *p, const char *fen)
+{
+    session_slot *slot = p->free;
+    game_state g;
+
+    memset(&g, 0, sizeof(g));
+    if (!slot || !fen_read(fen, &g))
+        return 0;
+
+    /* The free list link shares the slot with the game */
+    p->free = slot->next;
+    p->used++;
+    slot->s.position = g;
+    history_clear(&slot->s.history);
+    return &slot->s;
+}
+
+void session_close(session_pool *p, session *s)
+{
+    session_slot *slot = (session_slot *)s;
+    slot->next = p->free;
+    p->free = slot;
+    p->used--;
+}
+
+static uint8_t is_pawn(piece p)
+{
+    return p.type == 1 || p.type == 7;
+}
+
+/* Plays m if it is legal. Only from, to and the promotion piece are read:
+ * the flags history and unmake need are worked out here, and a promotion
+ * with none given is to a queen. */
+uint8_t session_move(session *s, packed_move m)
+{
+    game_state *g = &s->position;
+    uint8_t from = MOVE_FROM(m), to = MOVE_TO(m);
+    uint8_t index, captured, flags, promotion = 0;
+    undo_record u;
+    piece p;
+
+    if (!is_legal_move(*g, m))
+        return 0;
+
+    index = get_piece_index_at(from % 8, from / 8, *g);
+    p = g->pieces[index];
+    captured = get_piece_index_at(to % 8, to / 8, *g);
+
+    flags = move_flags(*g, p.type, from, to);
+    if (flags == MOVE_PROMOTION)
+        promotion = MOVE_FLAGS(m) == MOVE_PROMOTION ? MOVE_PROMOTES_TO(m) : PROMOTE_QUEEN;
+    else if (flags == MOVE_EN_PASSANT)
+        captured = get_piece_index_at(to % 8, from / 8, *g);
+
+    u.captured = captured == 32 ? NO_CAPTURE : captured;
+    u.first = p.first;
+    u.en_passant = g->can_en_passant ? g->en_passant_y*8 + g->en_passant_x : NO_EN_PASSANT;
+    u.halfmove_clock = g->halfmove_clock;
+
+    m = PACK_MOVE(from, to, flags, promotion);
+    *g = play_move(*g, m);
+    history_push(&s->history, m, u);
+    return 1;
+}
+
+/* 0 when there is nothing left to take back */
+uint8_t session_undo(session *s)
+{
+    undo_record u;
+    packed_move m;
+
+    if (!history_can_undo(&s->history))
+        return 0;
+    m = history_undo(&s->history, &u);
+    s->position = unmake_move(s->position, m, u);
+    return 1;
+}
+
+/* Legal moves of the side to move's piece on square (y*8+x) into moves,
+ * which has room for SESSION_MAX_MOVES. Returns how many. */
+uint8_t session_moves_from(session *s, uint8_t square, packed_move *moves)
+{
+    game_state *g = &s->position;
+    uint8_t index = get_piece_index_at(square % 8, square / 8, *g);
+    uint8_t i, k, n = 0;
+    move_set m;
+
+    if (index == 32 || g->pieces[index].team != g->turn)
+        return 0;
+
+    m = get_possible_moves_for_piece(g->pieces[index], *g);
+    for (i = 0; i < m.num_possible_moves; i++) {
+        uint8_t to = m.possible_moves_y[i]*8 + m.possible_moves_x[i];
+        if (to == square)
+            continue;           /* putting the piece back is not a move */
+        if (is_pawn(g->pieces[index]) && (to / 8 == 0 || to / 8 == 7)) {
+            for (k = PROMOTE_KNIGHT; k <= PROMOTE_QUEEN && n < SESSION_MAX_MOVES; k++)
+                moves[n++] = PACK_MOVE(square, to, MOVE_PROMOTION, k);
+        } else if (n < SESSION_MAX_MOVES) {
+            moves[n++] = PACK_MOVE(square, to, MOVE_NORMAL, 0);
+        }
+    }
+    return n;
+}
+
+uint8_t session_status(session *s)
+{
+    uint8_t status = check_checkmate(s->position);
+    if (status == 2)
+        return SESSION_CHECKMATE;
+    if (!are_there_possible_moves(s->position))
+        return SESSION_STALEMATE;
+    return status ? SESSION_CHECK : SESSION_PLAYING;
+}
+
+void session_fen(session *s, char *fen)
+{
+    fen_write(&s->position, fen);
+}
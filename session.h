@@ -0,0 +1,52 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Games that are not on the screen: a position and its move history in one
+ *  session, with every call taking the session it works on, so any number
+ *  of games can be in play at once. Sessions come from a pool over storage
+ *  the caller provides, with no malloc. A pool belongs to one thread, or
+ *  the caller locks around it; separate sessions need no locking.
+ */
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "chess.h"
+#include "history.h"
+
+#define SESSION_MAX_MOVES   32      /* moves of one piece, promotions counted four times */
+
+#define SESSION_PLAYING     0
+#define SESSION_CHECK       1
+#define SESSION_CHECKMATE   2
+#define SESSION_STALEMATE   3
+
+typedef struct {
+    game_state position;
+    move_history history;
+} session;
+
+/* A free slot holds the next free slot instead of a game */
+typedef union session_slot {
+    session s;
+    union session_slot *next;
+} session_slot;
+
+typedef struct {
+    session_slot *free;
+    uint16_t used;
+    uint16_t capacity;
+} session_pool;
+
+void session_pool_init(session_pool *p, session_slot *slots, uint16_t capacity);
+session *session_open(session_pool *p, const char *fen);
+void session_close(session_pool *p, session *s);
+
+uint8_t session_move(session *s, packed_move m);
+uint8_t session_undo(session *s);
+uint8_t session_moves_from(session *s, uint8_t square, packed_move *moves);
+uint8_t session_status(session *s);
+void session_fen(session *s, char *fen);
+
+#endif
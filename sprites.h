@@ -0,0 +1,157 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Piece images. Defines the data, so include it from chess.c only; other
+ *  files use the extern declarations in chess.h.
+ */
+
+sprite king = {{{0x00, 0x18, 0x00},
+                {0x00, 0x18, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x18, 0x00},
+                {0x00, 0x18, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0xFF, 0x00},
+                {0x01, 0xFF, 0x80},
+                {0x00, 0xFF, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x18, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0xFF, 0x00},
+                {0x00, 0xFF, 0x00},
+                {0x01, 0xFF, 0x80},
+                {0x01, 0xFF, 0x80},
+                {0x03, 0xFF, 0xC0},
+                {0x03, 0xFF, 0xC0}}};
+
+sprite queen = {{{0x01, 0x5A, 0x80},
+                 {0x01, 0x5A, 0x80},
+                 {0x01, 0xFF, 0x80},
+                 {0x00, 0xFF, 0x00},
+                 {0x00, 0x3C, 0x00},
+                 {0x00, 0x7E, 0x00},
+                 {0x00, 0xFF, 0x00},
+                 {0x00, 0xFF, 0x00},
+                 {0x00, 0xFF, 0x00},
+                 {0x00, 0x7E, 0x00},
+                 {0x00, 0x3C, 0x00},
+                 {0x00, 0xFF, 0x00},
+                 {0x01, 0xFF, 0x80},
+                 {0x01, 0xFF, 0x80},
+                 {0x00, 0x3C, 0x00},
+                 {0x00, 0x3C, 0x00},
+                 {0x00, 0x7E, 0x00},
+                 {0x00, 0x7E, 0x00},
+                 {0x00, 0xFF, 0x00},
+                 {0x00, 0xFF, 0x00},
+                 {0x01, 0xFF, 0x80},
+                 {0x01, 0xFF, 0x80},
+                 {0x03, 0xFF, 0xC0},
+                 {0x03, 0xFF, 0xC0},}};
+
+sprite bishop = {{{0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x18, 0x00},
+                  {0x00, 0x3C, 0x00},
+                  {0x00, 0x38, 0x00},
+                  {0x00, 0x72, 0x00},
+                  {0x00, 0x76, 0x00},
+                  {0x00, 0x7E, 0x00},
+                  {0x00, 0x3C, 0x00},
+                  {0x00, 0x3C, 0x00},
+                  {0x00, 0x18, 0x00},
+                  {0x00, 0x7E, 0x00},
+                  {0x00, 0xFF, 0x00},
+                  {0x00, 0x18, 0x00},
+                  {0x00, 0x3C, 0x00},
+                  {0x00, 0x3C, 0x00},
+                  {0x00, 0x7E, 0x00},
+                  {0x00, 0x7E, 0x00},
+                  {0x00, 0xFF, 0x00},
+                  {0x00, 0xFF, 0x00},
+                  {0x01, 0xFF, 0x80},
+                  {0x01, 0xFF, 0x80}}};
+
+sprite rook = {{{0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x99, 0x00},
+                {0x00, 0x99, 0x00},
+                {0x00, 0x99, 0x00},
+                {0x00, 0xFF, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x18, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0xFF, 0x00},
+                {0x00, 0xFF, 0x00}}};
+
+sprite knight = {{{0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x00, 0x00},
+                  {0x00, 0x38, 0x00},
+                  {0x00, 0x5C, 0x00},
+                  {0x01, 0xFC, 0x00},
+                  {0x03, 0xF8, 0x00},
+                  {0x03, 0xFC, 0x00},
+                  {0x01, 0x9E, 0x00},
+                  {0x00, 0x1E, 0x00},
+                  {0x00, 0x3E, 0x00},
+                  {0x00, 0x3E, 0x00},
+                  {0x00, 0x7E, 0x00},
+                  {0x00, 0x7F, 0x00},
+                  {0x00, 0x7F, 0x00},
+                  {0x00, 0xFF, 0x00},
+                  {0x00, 0xFF, 0x00},
+                  {0x00, 0xFF, 0x00},
+                  {0x01, 0xFF, 0x80},
+                  {0x01, 0xFF, 0x80}}};
+
+sprite pawn = {{{0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x00, 0x00},
+                {0x00, 0x18, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x18, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x18, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x3C, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0x7E, 0x00},
+                {0x00, 0xFF, 0x00},
+                {0x00, 0xFF, 0x00}}};
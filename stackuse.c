@@ -0,0 +1,264 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Host tool: worst case stack depth from the call graph GCC writes with
+ *  -fcallgraph-info=su (one .ci file per source file). Each root (main and
+ *  every *_vect handler) gets its deepest path, and the total is main plus
+ *  the deepest handler, since a handler can interrupt main at any depth.
+ *
+ *      avr-gcc -mmcu=at90usb1286 -Os -fcallgraph-info=su -c *.c
+ *      gcc -O2 -o stackuse stackuse.c
+ *      ./stackuse -r negamax=3 -e __indirect_call=menu_export_pgn *.ci
+ *
+ *  -c n        bytes pushed by each call for the return address (default 2)
+ *  -r f=n      f calls itself at most n deep (default 1, with a warning)
+ *  -e f=g      f may call g; use __indirect_call for function pointers
+ *
+ *  Functions with no stack figure (libc, assembler) count as 0 and are listed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_FUNCTIONS   1024
+#define MAX_EDGES       8192
+#define MAX_NAME        128
+
+typedef struct {
+    char title[MAX_NAME];       /* "file.c:name" for static functions */
+    const char *name;           /* after the last ':' */
+    long frame;                 /* -1 when no .ci file gave a size */
+    int recursion;
+    long worst;                 /* -1 until worked out */
+    int next;                   /* callee on the worst path, -1 for none */
+    int visiting;
+    int printed;
+} function;
+
+static function functions[MAX_FUNCTIONS];
+static int function_count;
+static int edge_from[MAX_EDGES], edge_to[MAX_EDGES];
+static int edge_count;
+static long call_bytes = 2;
+
+static int find(const char *title, int create)
+{
+    int i;
+    for (i = 0; i < function_count; i++)
+        if (strcmp(functions[i].title, title) == 0)
+            return i;
+    if (!create)
+        return -1;
+    if (function_count == MAX_FUNCTIONS) {
+        fprintf(stderr, "too many functions\n");
+        exit(1);
+    }
+    function *f = &functions[function_count];
+    snprintf(f->title, MAX_NAME, "%s", title);
+    f->name = strrchr(f->title, ':') ? strrchr(f->title, ':') + 1 : f->title;
+    f->frame = -1;
+    f->recursion = 0;
+    f->worst = -1;
+    f->next = -1;
+    return function_count++;
+}
+
+/* A plain name as given on the command line matches "name" or "file.c:name" */
+static int find_name(const char *name)
+{
+    int i;
+    for (i = 0; i < function_count; i++)
+        if (strcmp(functions[i].name, name) == 0)
+            return i;
+    return find(name, 1);
+}
+
+static void add_edge(int from, int to)
+{
+    int i;
+    for (i = 0; i < edge_count; i++)
+        if (edge_from[i] == from && edge_to[i] == to)
+            return;
+    if (edge_count == MAX_EDGES) {
+        fprintf(stderr, "too many calls\n");
+        exit(1);
+    }
+    edge_from[edge_count] = from;
+    edge_to[edge_count] = to;
+    edge_count++;
+}
+
+/* The quoted value after key, copied into out */
+static int field(const char *line, const char *key, char *out)
+{
+    const char *p = strstr(line, key);
+    size_t n = 0;
+    if (!p)
+        return 0;
+    p += strlen(key);
+    while (*p && *p != '"' && n < MAX_NAME - 1)
+        out[n++] = *p++;
+    out[n] = '\0';
+    return 1;
+}
+
+static void read_ci(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    char line[1024], title[MAX_NAME], label[MAX_NAME], target[MAX_NAME];
+
+    if (!f) {
+        perror(path);
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "node:", 5) == 0 && field(line, "title: \"", title)) {
+            int i = find(title, 1);
+            /* label: "name\nfile:line:col\nN bytes (static)" */
+            if (field(line, "label: \"", label)) {
+                char *bytes = strstr(label, " bytes");
+                if (bytes) {
+                    while (bytes > label && bytes[-1] >= '0' && bytes[-1] <= '9')
+                        bytes--;
+                    functions[i].frame = atol(bytes);
+                }
+            }
+        } else if (strncmp(line, "edge:", 5) == 0 && field(line, "sourcename: \"", title)
+                && field(line, "targetname: \"", target)) {
+            add_edge(find(title, 1), find(target, 1));
+        }
+    }
+    fclose(f);
+}
+
+static long worst(int i)
+{
+    function *f = &functions[i];
+    long deepest = 0;
+    int e;
+
+    if (f->worst >= 0)
+        return f->worst;
+    if (f->visiting) {
+        fprintf(stderr, "warning: %s is reached again through a cycle, counted once\n", f->name);
+        return 0;
+    }
+    f->visiting = 1;
+    for (e = 0; e < edge_count; e++) {
+        long d;
+        if (edge_from[e] != i || edge_to[e] == i)
+            continue;
+        /* The placeholder stands for the call itself, already counted */
+        d = (strcmp(f->title, "__indirect_call") == 0 ? 0 : call_bytes) + worst(edge_to[e]);
+        if (d > deepest) {
+            deepest = d;
+            f->next = edge_to[e];
+        }
+    }
+    f->visiting = 0;
+
+    /* Direct recursion: the frame repeats, then the deepest other callee */
+    long frame = f->frame > 0 ? f->frame : 0;
+    long depth = f->recursion > 1 ? f->recursion : 1;
+    for (e = 0; e < edge_count; e++) {
+        if (edge_from[e] == i && edge_to[e] == i && !f->recursion) {
+            fprintf(stderr, "warning: %s calls itself, counted once (use -r)\n", f->name);
+            break;
+        }
+    }
+    f->worst = depth * frame + (depth - 1) * call_bytes + deepest;
+    return f->worst;
+}
+
+static void print_path(int i)
+{
+    int j;
+    for (j = 0; j < function_count; j++)
+        functions[j].printed = 0;
+    while (i >= 0) {
+        function *f = &functions[i];
+        if (f->printed) {
+            printf("    %s again (cycle)\n", f->name);
+            break;
+        }
+        f->printed = 1;
+        if (f->frame < 0)
+            printf("    %-32s      ?\n", f->name);
+        else if (f->recursion > 1)
+            printf("    %-32s %6ld x %d\n", f->name, f->frame, f->recursion);
+        else
+            printf("    %-32s %6ld\n", f->name, f->frame);
+        i = f->next;
+    }
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: stackuse [-c bytes] [-r function=depth] [-e caller=callee] file.ci...\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    char *options[64];
+    int option_count = 0;
+    int i, main_root = -1, deepest_handler = -1;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            call_bytes = atol(argv[++i]);
+        } else if ((strcmp(argv[i], "-r") == 0 || strcmp(argv[i], "-e") == 0) && i + 1 < argc) {
+            if (option_count == 64)
+                usage();
+            options[option_count++] = argv[i];
+            options[option_count++] = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage();
+        } else {
+            read_ci(argv[i]);
+        }
+    }
+    if (function_count == 0)
+        usage();
+
+    for (i = 0; i < option_count; i += 2) {
+        char *equals = strchr(options[i + 1], '=');
+        if (!equals)
+            usage();
+        *equals = '\0';
+        if (options[i][1] == 'r')
+            functions[find_name(options[i + 1])].recursion = atoi(equals + 1);
+        else
+            add_edge(find_name(options[i + 1]), find_name(equals + 1));
+    }
+
+    for (i = 0; i < function_count; i++) {
+        const char *name = functions[i].name;
+        size_t n = strlen(name);
+        if (strcmp(name, "main") == 0) {
+            main_root = i;
+        } else if (n > 5 && strcmp(name + n - 5, "_vect") == 0) {
+            if (deepest_handler < 0 || worst(i) > worst(deepest_handler))
+                deepest_handler = i;
+        } else {
+            continue;
+        }
+        printf("%s: %ld bytes\n", name, worst(i));
+        print_path(i);
+    }
+
+    printf("no stack figure:");
+    for (i = 0; i < function_count; i++)
+        if (functions[i].frame < 0 && strcmp(functions[i].title, "__indirect_call") != 0)
+            printf(" %s", functions[i].name);
+    printf("\n");
+
+    if (main_root >= 0)
+        printf("worst case: %ld bytes (main %ld + %s %ld)\n",
+               worst(main_root) + (deepest_handler >= 0 ? call_bytes + worst(deepest_handler) : 0),
+               worst(main_root), deepest_handler >= 0 ? functions[deepest_handler].name : "no handler",
+               deepest_handler >= 0 ? call_bytes + worst(deepest_handler) : 0);
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#ifdef __AVR__
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#else
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include "uart.h"
+
+#define RX_SLOT(n)  ((n) & (UART_RX_SIZE - 1))
+#define TX_SLOT(n)  ((n) & (UART_TX_SIZE - 1))
+
+/* Each index is written by one side only: head by the consumer, tail by the producer */
+static volatile char rx_buffer[UART_RX_SIZE];
+static volatile uint8_t rx_head, rx_tail;
+static volatile char tx_buffer[UART_TX_SIZE];
+static volatile uint8_t tx_head, tx_tail;
+
+
+
+#ifdef __AVR__
+
+void uart_init(void)
+{
+    UBRR1 = UART_UBRR;
+    UCSR1A = 0;
+    UCSR1C = _BV(UCSZ11) | _BV(UCSZ10);
+    UCSR1B = _BV(RXEN1) | _BV(TXEN1) | _BV(RXCIE1);
+}
+
+/* A byte arrived; dropped if the ring is full */
+void uart_received(void)
+{
+    char c = UDR1;
+    if (RX_SLOT(rx_tail + 1) != rx_head) {
+        rx_buffer[rx_tail] = c;
+        rx_tail = RX_SLOT(rx_tail + 1);
+    }
+}
+
+/* Data register empty: send the next byte or stop asking */
+void uart_transmit_ready(void)
+{
+    if (tx_head == tx_tail) {
+        UCSR1B &= ~_BV(UDRIE1);
+        return;
+    }
+    UDR1 = tx_buffer[tx_head];
+    tx_head = TX_SLOT(tx_head + 1);
+}
+
+static void start_transmit(void)
+{
+    UCSR1B |= _BV(UDRIE1);
+}
+
+#else
+
+void uart_init(void)
+{
+    fcntl(0, F_SETFL, fcntl(0, F_GETFL) | O_NONBLOCK);
+}
+
+/* Whatever stdin has now */
+void uart_received(void)
+{
+    char c;
+    while (RX_SLOT(rx_tail + 1) != rx_head && read(0, &c, 1) == 1) {
+        rx_buffer[rx_tail] = c;
+        rx_tail = RX_SLOT(rx_tail + 1);
+    }
+}
+
+void uart_transmit_ready(void)
+{
+    while (tx_head != tx_tail) {
+        putchar(tx_buffer[tx_head]);
+        tx_head = TX_SLOT(tx_head + 1);
+    }
+    fflush(stdout);
+}
+
+static void start_transmit(void)
+{
+    uart_transmit_ready();
+}
+
+#endif
+
+
+
+uint8_t uart_rx_pending(void)
+{
+#ifndef __AVR__
+    uart_received();
+#endif
+    return rx_head != rx_tail;
+}
+
+uint8_t uart_getc(char *c)
+{
+    if (!uart_rx_pending())
+        return 0;
+    *c = rx_buffer[rx_head];
+    rx_head = RX_SLOT(rx_head + 1);
+    return 1;
+}
+
+/* Never waits: 0 and the byte is dropped if the ring is full */
+uint8_t uart_putc(char c)
+{
+    if (TX_SLOT(tx_tail + 1) == tx_head) {
+        start_transmit();
+        return 0;
+    }
+    tx_buffer[tx_tail] = c;
+    tx_tail = TX_SLOT(tx_tail + 1);
+    start_transmit();
+    return 1;
+}
+
+/* 0 if any of it was dropped */
+uint8_t uart_puts(const char *s)
+{
+    uint8_t sent = 1;
+    while (*s)
+        sent &= uart_putc(*s++);
+    return sent;
+}
+
+void uart_flush(void)
+{
+    start_transmit();
+    while (tx_head != tx_tail)
+        ;
+}
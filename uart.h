@@ -0,0 +1,34 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  USART1 with interrupt driven receive and transmit rings, so nothing in
+ *  the main loop waits on the line. Host builds use stdin and stdout (a pty
+ *  works the same), read without blocking.
+ */
+
+#ifndef UART_H
+#define UART_H
+
+#include <stdint.h>
+
+/* 38400 baud 8N1 at 8MHz: UBRR = 8000000/(16*38400) - 1 = 12, 0.2% error */
+#define UART_UBRR       12
+
+#define UART_RX_SIZE    64      /* power of two */
+/* Power of two. The longest reply, "info ... nodes 4294967295\nbestmove e7e8q\n",
+ * is 61 bytes, so one fits behind another still leaving the line */
+#define UART_TX_SIZE    128
+
+void uart_init(void);
+uint8_t uart_getc(char *c);
+uint8_t uart_rx_pending(void);
+uint8_t uart_putc(char c);
+uint8_t uart_puts(const char *s);
+void uart_flush(void);
+
+/* Bodies of ISR(USART1_RX_vect) and ISR(USART1_UDRE_vect) */
+void uart_received(void);
+void uart_transmit_ready(void);
+
+#endif
@@ -0,0 +1,319 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ */
+
+#include <string.h>
+
+#include "uci.h"
+#include "uart.h"
+#include "rules.h"
+#include "clock.h"
+#include "profile.h"
+
+#define UCI_UNKNOWN     0
+#define UCI_UCI         1
+#define UCI_ISREADY     2
+#define UCI_NEWGAME     3
+#define UCI_POSITION    4
+#define UCI_GO          5
+#define UCI_QUIT        6
+
+#define STAGE_COMMAND   0
+#define STAGE_POSITION  1       /* startpos or fen */
+#define STAGE_FEN       2       /* FEN fields, up to six */
+#define STAGE_MOVES     3       /* "moves" expected */
+#define STAGE_MOVE      4       /* each word a move */
+#define STAGE_GO        5       /* a go keyword */
+#define STAGE_GO_VALUE  6       /* the number for limits[go_key] */
+
+#define GO_MOVETIME     4
+#define GO_DEPTH        5
+
+static const char * const commands[] = {"uci", "isready", "ucinewgame", "position", "go", "quit"};
+static const char * const go_keywords[] = {"wtime", "btime", "winc", "binc", "movetime", "depth"};
+
+void uci_init(uci_state *u)
+{
+    u->length = 0;
+    u->stage = STAGE_COMMAND;
+    u->failed = 0;
+    u->position_changed = 0;
+    u->quit = 0;
+    fen_read(START_FEN, &u->position);
+    repetition_clear(&u->keys, &u->position);
+}
+
+static void send_number(uint32_t n)
+{
+    char digits[10];
+    uint8_t i = 0;
+    do {
+        digits[i++] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    while (i)
+        uart_putc(digits[--i]);
+}
+
+static void send_move(packed_move m)
+{
+    static const char promotions[4] = {'n', 'b', 'r', 'q'};
+    if (m == ENGINE_NO_MOVE) {
+        uart_puts("0000");
+        return;
+    }
+    uart_putc('a' + MOVE_FROM(m) % 8);
+    uart_putc('8' - MOVE_FROM(m) / 8);
+    uart_putc('a' + MOVE_TO(m) % 8);
+    uart_putc('8' - MOVE_TO(m) / 8);
+    if (MOVE_FLAGS(m) == MOVE_PROMOTION)
+        uart_putc(promotions[MOVE_PROMOTES_TO(m)]);
+}
+
+/* "e2e4" or "e7e8q" to a packed move, ENGINE_NO_MOVE if malformed */
+static packed_move parse_move(const char *w, uint8_t length)
+{
+    static const char promotions[4] = {'n', 'b', 'r', 'q'};
+    uint8_t i;
+
+    if (length < 4 || length > 5
+     || w[0] < 'a' || w[0] > 'h' || w[1] < '1' || w[1] > '8'
+     || w[2] < 'a' || w[2] > 'h' || w[3] < '1' || w[3] > '8')
+        return ENGINE_NO_MOVE;
+
+    uint8_t from = ('8' - w[1]) * 8 + w[0] - 'a';
+    uint8_t to = ('8' - w[3]) * 8 + w[2] - 'a';
+    if (length == 4)
+        return PACK_MOVE(from, to, MOVE_NORMAL, 0);
+    for (i = 0; i < 4; i++)
+        if (w[4] == promotions[i])
+            return PACK_MOVE(from, to, MOVE_PROMOTION, i);
+    return ENGINE_NO_MOVE;
+}
+
+/* A pawn reaching the last rank without a suffix becomes a queen */
+static packed_move with_promotion(game_state *g, packed_move m)
+{
+    uint8_t from = MOVE_FROM(m), to = MOVE_TO(m);
+    uint8_t index = get_piece_index_at(from % 8, from / 8, *g);
+    if (MOVE_FLAGS(m) == MOVE_NORMAL && index != 32
+     && ((g->pieces[index].type == 1 && to / 8 == 0) || (g->pieces[index].type == 7 && to / 8 == 7)))
+        return PACK_MOVE(from, to, MOVE_PROMOTION, PROMOTE_QUEEN);
+    return m;
+}
+
+static void finish_fen(uci_state *u)
+{
+    u->fen[u->fen_length] = '\0';
+    if (!fen_read(u->fen, &u->position))
+        u->failed = 1;
+    repetition_clear(&u->keys, &u->position);
+    u->stage = STAGE_MOVES;
+}
+
+static void go(uci_state *u)
+{
+    uint32_t *l = u->limits;
+    uint32_t limit = UCI_DEFAULT_TICKS;
+    uint8_t side = u->position.turn;
+
+    if (l[GO_MOVETIME]) {
+        limit = l[GO_MOVETIME] * 125 / 4;   /* ms to 32us ticks */
+    } else if (l[side]) {
+        /* Let the game clock's time manager share out what is left */
+        chess_clock c;
+        uint32_t now = profile_now();
+        clock_init(&c, 0, 0, CLOCK_FISCHER);
+        c.remaining[side] = l[side] * 125 / 4;
+        c.increment = l[2 + side] * 125 / 4;
+        c.moves = (u->position.fullmove_number - 1) * 2;
+        c.side = side;
+        c.turn_start = now;
+        c.running = 1;
+        limit = clock_budget(&c, side, now);
+        if (!limit)
+            limit = 1;
+    } else if (l[GO_DEPTH]) {
+        limit = 0;
+    }
+
+    search_init(&u->search, limit, l[GO_DEPTH] ? l[GO_DEPTH] : ENGINE_MAX_DEPTH);
+    u->search.keys = &u->keys;
+    search(&u->search, u->position);
+
+    uart_puts("info depth ");
+    send_number(u->search.depth);
+    uart_puts(" score cp ");
+    if (u->search.score < 0) {
+        uart_putc('-');
+        send_number(-u->search.score);
+    } else {
+        send_number(u->search.score);
+    }
+    uart_puts(" nodes ");
+    send_number(u->search.nodes);
+    uart_puts("\nbestmove ");
+    send_move(u->search.best);
+    uart_putc('\n');
+}
+
+/* A whole word has arrived (FEN fields go straight into u->fen) */
+static void word(uci_state *u)
+{
+    char *w = u->word;
+    uint8_t i;
+
+    w[u->length < UCI_WORD ? u->length : UCI_WORD - 1] = '\0';
+    if (u->failed)
+        return;
+
+    switch (u->stage) {
+    case STAGE_COMMAND:
+        u->command = UCI_UNKNOWN;
+        for (i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+            if (strcmp(w, commands[i]) == 0)
+                u->command = i + 1;
+        if (u->command == UCI_POSITION)
+            u->stage = STAGE_POSITION;
+        if (u->command == UCI_GO) {
+            memset(u->limits, 0, sizeof(u->limits));
+            u->stage = STAGE_GO;
+        }
+        break;
+
+    case STAGE_POSITION:
+        if (strcmp(w, "startpos") == 0) {
+            fen_read(START_FEN, &u->position);
+            repetition_clear(&u->keys, &u->position);
+            u->stage = STAGE_MOVES;
+        } else if (strcmp(w, "fen") == 0) {
+            u->fen_length = 0;
+            u->fen_fields = 0;
+            u->stage = STAGE_FEN;
+        } else {
+            u->failed = 1;
+        }
+        break;
+
+    case STAGE_MOVES:
+        if (strcmp(w, "moves") == 0)
+            u->stage = STAGE_MOVE;
+        else
+            u->failed = 1;
+        break;
+
+    case STAGE_MOVE: {
+        packed_move m = with_promotion(&u->position, parse_move(w, u->length));
+        if (m == ENGINE_NO_MOVE || !is_legal_move(u->position, m)) {
+            u->failed = 1;
+        } else {
+            u->position = play_move(u->position, m);
+            repetition_push(&u->keys, &u->position);
+        }
+        break;
+    }
+
+    case STAGE_GO:
+        for (i = 0; i < sizeof(go_keywords) / sizeof(go_keywords[0]); i++) {
+            if (strcmp(w, go_keywords[i]) == 0) {
+                u->go_key = i;
+                u->stage = STAGE_GO_VALUE;
+            }
+        }
+        break;
+
+    case STAGE_GO_VALUE: {
+        uint32_t n = 0;
+        for (i = 0; w[i] >= '0' && w[i] <= '9'; i++)
+            n = n * 10 + w[i] - '0';
+        u->limits[u->go_key] = n;
+        u->stage = STAGE_GO;
+        break;
+    }
+    }
+}
+
+static void line(uci_state *u)
+{
+    if (u->stage == STAGE_FEN)
+        finish_fen(u);
+
+    switch (u->command) {
+    case UCI_UCI:
+        uart_puts("id name LaFortunaChess\nid author Ben Gibbs\nuciok\n");
+        break;
+    case UCI_ISREADY:
+        uart_puts("readyok\n");
+        break;
+    case UCI_NEWGAME:
+        fen_read(START_FEN, &u->position);
+        repetition_clear(&u->keys, &u->position);
+        break;
+    case UCI_POSITION:
+        if (!u->failed)
+            u->position_changed = 1;
+        break;
+    case UCI_GO:
+        go(u);
+        break;
+    case UCI_QUIT:
+        u->quit = 1;
+        break;
+    }
+
+    u->command = UCI_UNKNOWN;
+    u->stage = STAGE_COMMAND;
+    u->failed = 0;
+}
+
+static void fen_char(uci_state *u, char c)
+{
+    if (u->fen_length < FEN_MAX - 1)
+        u->fen[u->fen_length++] = c;
+}
+
+/* Everything the UART has received so far */
+void uci_poll(uci_state *u)
+{
+    char c;
+    while (uart_getc(&c)) {
+        if (c == '\r')
+            continue;
+
+        if (u->stage == STAGE_FEN) {
+            /* Six fields, or fewer if "moves" comes first */
+            if (c == ' ' || c == '\t' || c == '\n') {
+                u->fen[u->fen_length] = '\0';
+                if (u->fen_length >= 5 && strcmp(u->fen + u->fen_length - 5, "moves") == 0
+                 && (u->fen_length == 5 || u->fen[u->fen_length - 6] == ' ')) {
+                    u->fen_length -= u->fen_length == 5 ? 5 : 6;
+                    finish_fen(u);
+                    u->stage = u->failed ? STAGE_MOVES : STAGE_MOVE;
+                } else if (u->fen_length && u->fen[u->fen_length - 1] != ' ') {
+                    if (++u->fen_fields == 6)
+                        finish_fen(u);
+                    else
+                        fen_char(u, ' ');
+                }
+                if (c == '\n')
+                    line(u);
+            } else {
+                fen_char(u, c);
+            }
+            continue;
+        }
+
+        if (c == ' ' || c == '\t' || c == '\n') {
+            if (u->length)
+                word(u);
+            u->length = 0;
+            if (c == '\n')
+                line(u);
+        } else {
+            if (u->length < UCI_WORD)
+                u->word[u->length] = c;
+            u->length++;
+        }
+    }
+}
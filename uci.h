@@ -0,0 +1,43 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  A UCI subset over the UART: uci, isready, ucinewgame,
+ *  position [startpos | fen <fen>] [moves ...], go [movetime | depth |
+ *  wtime btime winc binc], quit. Lines are parsed a word at a time as bytes
+ *  arrive, and moves are played as they are read, so no line is buffered.
+ */
+
+#ifndef UCI_H
+#define UCI_H
+
+#include "chess.h"
+#include "fen.h"
+#include "engine.h"
+#include "repetition.h"
+
+#define UCI_WORD            12      /* longest keyword or number kept */
+#define UCI_DEFAULT_TICKS   (5 * 31250UL)   /* "go" with no limits */
+
+typedef struct {
+    game_state position;
+    key_stack keys;             /* position and the moves played to reach it */
+    char word[UCI_WORD];
+    uint8_t length;
+    uint8_t command;            /* UCI_* of the line being read */
+    uint8_t stage;              /* what the next word means */
+    uint8_t failed;             /* rest of the line is ignored */
+    char fen[FEN_MAX];
+    uint8_t fen_length;
+    uint8_t fen_fields;
+    uint32_t limits[6];         /* go: wtime btime winc binc movetime (ms), depth */
+    uint8_t go_key;
+    uint8_t position_changed;   /* set after each position command */
+    uint8_t quit;
+    search_context search;
+} uci_state;
+
+void uci_init(uci_state *u);
+void uci_poll(uci_state *u);
+
+#endif
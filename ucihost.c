@@ -0,0 +1,30 @@
+/*  Author: Ben Gibbs
+ * Licence: This work is licensed under the Creative Commons Attribution License.
+ *           View this license at http://creativecommons.org/about/licenses/
+ *
+ *  Host tool: the board's UCI protocol, search and rules on stdin/stdout, so
+ *  a GUI or another engine can talk to it directly or through a pty.
+ *
+ *      gcc -O2 -I. -o ucihost ucihost.c uci.c uart.c engine.c rules.c fen.c repetition.c clock.c profile.c
+ *      socat PTY,link=/tmp/lafortuna,raw,echo=0 EXEC:./ucihost
+ */
+
+#include <unistd.h>
+
+#include "uci.h"
+#include "uart.h"
+
+int main(void)
+{
+    static uci_state uci;
+
+    uart_init();
+    uci_init(&uci);
+    while (!uci.quit) {
+        if (!uart_rx_pending())
+            usleep(1000);
+        uci_poll(&uci);
+    }
+    uart_flush();
+    return 0;
+}